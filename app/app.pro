@@ -19,33 +19,54 @@ PKGCONFIG   += xcb xcb-ewmh dde-file-manager
 SOURCES += \
     main.cpp \
     config/config.cpp \
+    config/layoutjournal.cpp \
+    config/atomicfile.cpp \
+    config/inilayoutstore.cpp \
+    config/xattrlayoutstore.cpp \
     desktop.cpp \
     view/canvasviewhelper.cpp \
 #    view/canvasview.cpp \
     model/dfileselectionmodel.cpp \
+    model/itemregistry.cpp \
+    model/desktopwatcher.cpp \
     view/canvasgridview.cpp \
+    view/desktopsnapshot.cpp \
     presenter/apppresenter.cpp \
     presenter/gridmanager.cpp \
     dbus/dbusdisplay.cpp \
     presenter/display.cpp \
-    presenter/dfmsocketinterface.cpp
+    presenter/dfmsocketinterface.cpp \
+    presenter/dfminitializer.cpp
 
 
 
 HEADERS += \
     config/config.h \
+    config/layoutjournal.h \
+    config/atomicfile.h \
+    config/layoutstore.h \
+    config/inilayoutstore.h \
+    config/xattrlayoutstore.h \
+    config/flushstats.h \
+    config/configsnapshot.h \
+    config/layoutopqueue.h \
     desktop.h \
     view/canvasviewhelper.h \
     model/dfileselectionmodel.h \
+    model/itemregistry.h \
+    model/desktopwatcher.h \
     view/private/canvasviewprivate.h \
     global/coorinate.h \
     global/singleton.h \
+    global/mpscqueue.h \
     view/canvasgridview.h \
+    view/desktopsnapshot.h \
     presenter/apppresenter.h \
     presenter/gridmanager.h \
     dbus/dbusdisplay.h \
     presenter/display.h \
-    presenter/dfmsocketinterface.h
+    presenter/dfmsocketinterface.h \
+    presenter/dfminitializer.h
 
 RESOURCES += \
     resource/theme/theme.qrc
@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#include "atomicfile.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+AtomicFile::DirSyncPolicy AtomicFile::policyFromString(const QString &policy)
+{
+    if (policy == "never") {
+        return DirSyncNever;
+    }
+    if (policy == "always") {
+        return DirSyncAlways;
+    }
+    return DirSyncOnRename;
+}
+
+bool AtomicFile::write(const QString &path, const QByteArray &data, DirSyncPolicy policy)
+{
+    auto tmpPath = path + ".tmp";
+    QFile file(tmpPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "open temp file failed" << tmpPath << file.errorString();
+        return false;
+    }
+
+    if (file.write(data) != data.size() || !file.flush() || 0 != ::fsync(file.handle())) {
+        qWarning() << "write temp file failed" << tmpPath << file.errorString();
+        file.close();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    if (0 != ::rename(QFile::encodeName(tmpPath).constData(), QFile::encodeName(path).constData())) {
+        qWarning() << "replace file failed" << path << strerror(errno);
+        QFile::remove(tmpPath);
+        return false;
+    }
+
+    if (policy != DirSyncNever) {
+        return syncDirectory(QFileInfo(path).absolutePath());
+    }
+    return true;
+}
+
+bool AtomicFile::syncFile(const QString &path)
+{
+    auto fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        qWarning() << "open file failed" << path << strerror(errno);
+        return false;
+    }
+    auto ret = ::fsync(fd);
+    ::close(fd);
+    return 0 == ret;
+}
+
+bool AtomicFile::syncDirectory(const QString &path)
+{
+    auto fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        qWarning() << "open directory failed" << path << strerror(errno);
+        return false;
+    }
+    auto ret = ::fsync(fd);
+    ::close(fd);
+    return 0 == ret;
+}
@@ -0,0 +1,33 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+
+// Durable file replacement: write a temp file next to the target, fsync
+// it and rename it over the target, so a crash leaves either the old or
+// the new content on disk, never a torn mix.
+class AtomicFile
+{
+public:
+    // the rename itself only survives a power loss once the parent
+    // directory has been synced as well
+    enum DirSyncPolicy {
+        DirSyncNever,
+        DirSyncOnRename,    // after a file is created or replaced
+        DirSyncAlways,      // after every flush, appends included
+    };
+
+    static DirSyncPolicy policyFromString(const QString &policy);
+
+    static bool write(const QString &path, const QByteArray &data, DirSyncPolicy policy);
+    static bool syncFile(const QString &path);
+    static bool syncDirectory(const QString &path);
+};
@@ -7,15 +7,25 @@
  * (at your option) any later version.
  **/
 #include "config.h"
+#include "layoutjournal.h"
+#include "inilayoutstore.h"
+#include "xattrlayoutstore.h"
+#include "atomicfile.h"
 
 #include <QThread>
+#include <QMutexLocker>
 #include <QStandardPaths>
 #include <QApplication>
+#include <QSessionManager>
 #include <QDir>
 #include <QFileInfo>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QDateTime>
 #include <QDebug>
 
+#include <algorithm>
+
 const QString Config::groupGeneral = "GeneralConfig";
 const QString Config::keyProfile = "Profile";
 const QString Config::keySortBy = "SortBy";
@@ -23,6 +33,32 @@ const QString Config::keySortOrder = "SortOrder";
 const QString Config::keyAutoAlign = "AutoSort";
 const QString Config::keyIconLevel = "IconLevel";
 const QString Config::keyQuickHide = "QuickHide";
+const QString Config::keyLayoutStorage = "LayoutStorage";
+const QString Config::keyDirSync = "DirSync";
+const QString Config::keyProfileRetention = "ProfileRetention";
+const QString Config::groupProfileUsage = "ProfileUsage";
+
+namespace
+{
+const QString positionGroupPrefix = "Position_";
+const QString layoutStorageJournal = "journal";
+const QString layoutStorageXattr = "xattr";
+
+// dump the flush histograms every so many flushes
+const quint64 statsDumpInterval = 64;
+
+// a single edit is flushed after minFlushDelay, every further edit in the
+// window doubles the delay up to maxFlushDelay, and nothing stays dirty
+// longer than maxFlushLatency
+const int minFlushDelay = 200;
+const int maxFlushDelay = 2000;
+const qint64 maxFlushLatency = 5000;
+
+// stale profiles are collected once the desktop has settled after start
+const int profileGcDelay = 60 * 1000;
+const int profileGcRetry = 10 * 1000;
+const int defaultProfileRetention = 8;
+}
 
 
 Config::Config()
@@ -39,54 +75,642 @@ Config::Config()
     if (!configFile.exists()) {
         configFile.absoluteDir().mkpath(".");
     }
-    m_settings = new QSettings(configPath, QSettings::IniFormat);
+    // parented so that it follows Config, and its own deferred syncs, to the worker
+    m_settings = new QSettings(configPath, QSettings::IniFormat, this);
+
+    m_settings->beginGroup(groupGeneral);
+    m_dirSyncPolicy = AtomicFile::policyFromString(m_settings->value(keyDirSync).toString());
+    m_settings->endGroup();
+    loadState();
+
+    // children of Config, so they move to the worker thread below
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &Config::flush);
+
+    m_profileGcTimer = new QTimer(this);
+    m_profileGcTimer->setSingleShot(true);
+    m_profileGcTimer->setInterval(profileGcDelay);
+    connect(m_profileGcTimer, &QTimer::timeout, this, &Config::collectProfiles);
+
     auto work = new QThread(this);
     this->moveToThread(work);
     work->start();
+    // first in the queue, before any write can reach the worker
+    QMetaObject::invokeMethod(this, "loadLayout", Qt::QueuedConnection);
+    QMetaObject::invokeMethod(m_profileGcTimer, "start", Qt::QueuedConnection);
 
-    auto syncTimer = new QTimer();
-    syncTimer->setInterval(2000);
-    connect(syncTimer, &QTimer::timeout, this, [ = ]() {
-        if (needSync) {
-            needSync = false;
-            m_settings->sync();
+    connect(qApp, &QCoreApplication::aboutToQuit, qApp, [ = ]() {
+        flushSync();
+    });
+    connect(qApp, &QGuiApplication::commitDataRequest, qApp, [ = ](QSessionManager &) {
+        flushSync();
+    });
+}
+
+void Config::loadState()
+{
+    for (auto &group : m_settings->childGroups()) {
+        if (isLayoutGroup(group)) {
+            continue;
         }
-    }, Qt::QueuedConnection);
-    syncTimer->start();
+        auto &values = m_state.m_groups[group];
+        m_settings->beginGroup(group);
+        for (auto &key : m_settings->allKeys()) {
+            values.insert(key, m_settings->value(key));
+        }
+        m_settings->endGroup();
+    }
+    publish();
 }
 
-void Config::setConfig(const QString &group, const QString &key, const QVariant &value)
+// Open the layout store on the worker, the xattr store scans the whole
+// desktop folder and the GUI thread has better things to do meanwhile.
+void Config::loadLayout()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    auto layoutStorage = m_state.value(groupGeneral, keyLayoutStorage).toString();
+    initLayoutStore(layoutStorage, QFileInfo(m_settings->fileName()).absolutePath());
+
+    for (auto &profile : m_layoutStore->profiles()) {
+        auto &values = m_state.m_groups[profile];
+        auto entries = m_layoutStore->values(profile);
+        for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+            values.insert(it.key(), it.value());
+        }
+    }
+    publish();
+
+    QMutexLocker lock(&m_layoutMutex);
+    m_layoutReady = true;
+    m_layoutLoaded.wakeAll();
+    qDebug() << "load position profiles from" << m_layoutStore->name() << "in" << timer.elapsed() << "ms";
+}
+
+void Config::waitLayout() const
+{
+    if (m_layoutReady.load(std::memory_order_acquire) || QThread::currentThread() == thread()) {
+        return;
+    }
+
+    QMutexLocker lock(&m_layoutMutex);
+    while (!m_layoutReady) {
+        m_layoutLoaded.wait(&m_layoutMutex);
+    }
+}
+
+void Config::publish()
+{
+    ++m_state.m_version;
+    std::atomic_store(&m_snapshot, std::shared_ptr<const ConfigSnapshot>(new ConfigSnapshot(m_state)));
+}
+
+std::shared_ptr<const ConfigSnapshot> Config::snapshot() const
+{
+    // a short critical section, see benchmark/configstress for the TSan run
+    return std::atomic_load(&m_snapshot);
+}
+
+QVariant Config::value(const QString &group, const QString &key, const QVariant &defaultValue) const
+{
+    if (isLayoutGroup(group)) {
+        waitLayout();
+    }
+    return snapshot()->value(group, key, defaultValue);
+}
+
+QVariantMap Config::groupValues(const QString &group) const
+{
+    if (isLayoutGroup(group)) {
+        waitLayout();
+    }
+    return snapshot()->group(group);
+}
+
+void Config::touchProfile(const QString &profile)
+{
+    queueValue(groupProfileUsage, profile, QDateTime::currentMSecsSinceEpoch() / 1000);
+}
+
+// Keep the most recently used profiles plus the current one, every other
+// Position_WxH group is left over from a grid size not seen for long.
+void Config::collectProfiles()
+{
+    // layout ops still in the queue count as pending writes
+    drainLayoutOps();
+
+    // not idle yet, come back after the pending writes are flushed
+    if (m_flushTimer->isActive() || !m_persistent) {
+        m_profileGcTimer->start(profileGcRetry);
+        return;
+    }
+
+    auto current = m_state.value(groupGeneral, keyProfile).toString();
+    if (!current.isEmpty()) {
+        touchProfile(current);
+    }
+
+    auto retention = m_state.value(groupGeneral, keyProfileRetention, defaultProfileRetention).toInt();
+    auto usage = m_state.group(groupProfileUsage);
+
+    QList<QPair<qint64, QString> > profiles;
+    for (auto &group : m_state.groups()) {
+        if (isLayoutGroup(group) && group != current) {
+            profiles << qMakePair(usage.value(group).toLongLong(), group);
+        }
+    }
+    std::sort(profiles.begin(), profiles.end(), [](const QPair<qint64, QString> &a,
+    const QPair<qint64, QString> &b) {
+        return a.first > b.first;
+    });
+
+    QStringList staleProfiles;
+    int staleKeys = 0;
+    for (int i = qMax(0, retention); i < profiles.size(); ++i) {
+        auto &profile = profiles[i].second;
+        staleKeys += m_state.group(profile).size();
+        staleProfiles << profile;
+        queueRemove(profile, "");
+    }
+
+    // forget usage of profiles that are gone
+    for (auto &profile : usage.keys()) {
+        if (!m_state.m_groups.contains(profile)) {
+            queueRemove(groupProfileUsage, profile);
+        }
+    }
+    publish();
+
+    if (staleProfiles.isEmpty()) {
+        return;
+    }
+
+    // the same parse before and after, the way the next start reads it
+    auto parseBefore = probeSettings();
+    flush();
+    auto parseAfter = probeSettings();
+
+    qDebug() << "collect" << staleProfiles.size() << "stale profiles with" << staleKeys << "keys,"
+             << "config parse" << parseBefore << "ms ->" << parseAfter << "ms";
+}
+
+// time a cold parse of the config file by a fresh QSettings
+double Config::probeSettings() const
+{
+    QElapsedTimer timer;
+    timer.start();
+    QSettings probe(m_settings->fileName(), QSettings::IniFormat);
+    probe.allKeys();
+    return timer.nsecsElapsed() / 1e6;
+}
+
+bool Config::isPersistent() const
+{
+    return m_persistent;
+}
+
+void Config::enablePersistence()
+{
+    if (m_persistent.exchange(true)) {
+        return;
+    }
+
+    // the layout store loads first, see the constructor
+    finishMigration();
+    flush();
+    emit persistenceEnabled();
+}
+
+void Config::flushSync()
+{
+    if (QThread::currentThread() == thread()) {
+        flush();
+        return;
+    }
+    QMetaObject::invokeMethod(this, "flush", Qt::BlockingQueuedConnection);
+}
+
+void Config::scheduleFlush()
+{
+    if (!m_flushTimer->isActive()) {
+        m_dirtySince.start();
+        m_flushTimer->start(minFlushDelay);
+        return;
+    }
+
+    auto delay = qMin(m_flushTimer->interval() * 2, maxFlushDelay);
+    auto remain = qMax<qint64>(0, maxFlushLatency - m_dirtySince.elapsed());
+    m_flushTimer->start(static_cast<int>(qMin<qint64>(delay, remain)));
+}
+
+void Config::initLayoutStore(const QString &storage, const QString &configDir)
+{
+    if (storage == layoutStorageJournal) {
+        m_layoutStore = new LayoutJournal(configDir + "/layout.journal");
+    } else if (storage == layoutStorageXattr) {
+        auto desktopPath = QStandardPaths::standardLocations(QStandardPaths::DesktopLocation).first();
+        // for the files that cannot carry an attribute
+        auto fallback = new LayoutJournal(configDir + "/layout-fallback.journal");
+        m_layoutStore = new XattrLayoutStore(desktopPath, fallback);
+    }
+
+    if (m_layoutStore) {
+        m_layoutStore->setDirSyncPolicy(m_dirSyncPolicy);
+        if (!m_layoutStore->load()) {
+            qWarning() << m_layoutStore->name() << "unavailable, keep position profiles in"
+                       << m_settings->fileName();
+            delete m_layoutStore;
+            m_layoutStore = nullptr;
+        }
+    }
+
+    if (!m_layoutStore) {
+        m_iniLayoutStore = new IniLayoutStore(m_settings);
+        m_layoutStore = m_iniLayoutStore;
+        m_layoutStore->setDirSyncPolicy(m_dirSyncPolicy);
+        m_layoutStore->load();
+        return;
+    }
+
+    migrateProfiles();
+}
+
+// Move position profiles written by the ini store over once. The copy
+// is made at load so the profiles are there from the start, the ini
+// groups are dropped by finishMigration().
+void Config::migrateProfiles()
+{
+    auto profiles = m_layoutStore->profiles();
+    for (auto &group : m_settings->childGroups()) {
+        if (!isLayoutGroup(group)) {
+            continue;
+        }
+        if (!profiles.contains(group)) {
+            m_settings->beginGroup(group);
+            for (auto &key : m_settings->childKeys()) {
+                m_layoutStore->setValue(group, key, m_settings->value(key).toString());
+            }
+            m_settings->endGroup();
+        }
+        m_migratedGroups << group;
+    }
+    finishMigration();
+}
+
+// The ini groups are only dropped after the new store has them on disk,
+// a failed sync keeps them for the next start to retry.
+void Config::finishMigration()
+{
+    if (m_migratedGroups.isEmpty() || !m_persistent) {
+        return;
+    }
+
+    auto groups = m_migratedGroups;
+    m_migratedGroups.clear();
+    if (!m_layoutStore->sync()) {
+        qWarning() << "migrate position profiles to" << m_layoutStore->name()
+                   << "failed, keep them in" << m_settings->fileName();
+        return;
+    }
+
+    for (auto &group : groups) {
+        m_settings->remove(group);
+    }
+    m_settings->sync();
+    qDebug() << "migrate" << groups.size() << "position profiles to" << m_layoutStore->name();
+}
+
+bool Config::isLayoutGroup(const QString &group) const
+{
+    return group.startsWith(positionGroupPrefix);
+}
+
+// QSettings already replaces the file through a temp file and a rename,
+// make the new content and the rename durable before counting the flush
+void Config::syncSettings()
 {
+    QElapsedTimer timer;
+    timer.start();
+
+    m_settings->sync();
+    if (m_settings->status() != QSettings::NoError) {
+        qWarning() << "sync config failed" << m_settings->fileName() << m_settings->status();
+        return;
+    }
+
+    QFileInfo configFile(m_settings->fileName());
+    AtomicFile::syncFile(configFile.absoluteFilePath());
+    if (m_dirSyncPolicy != AtomicFile::DirSyncNever) {
+        AtomicFile::syncDirectory(configFile.absolutePath());
+    }
+
+    m_settingsStats.record(timer.nsecsElapsed(), configFile.size());
+    if (0 == m_settingsStats.count() % statsDumpInterval) {
+        m_settingsStats.dump();
+    }
+}
+
+void Config::syncLayoutStore()
+{
+    if (!m_layoutStore->isDirty()) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    auto bytesWritten = m_layoutStore->bytesWritten();
+
+    m_layoutStore->sync();
+
+    m_layoutStats.record(timer.nsecsElapsed(), m_layoutStore->bytesWritten() - bytesWritten);
+    if (0 == m_layoutStats.count() % statsDumpInterval) {
+        m_layoutStats.dump();
+    }
+}
+
+bool Config::storeContains(const QString &group, const QString &key) const
+{
+    if (isLayoutGroup(group)) {
+        return m_layoutStore->contains(group, key);
+    }
+    return m_settings->contains(group + "/" + key);
+}
+
+void Config::storeValue(const QString &group, const QString &key, const QVariant &value)
+{
+    if (isLayoutGroup(group)) {
+        m_layoutStore->setValue(group, key, value.toString());
+        return;
+    }
+
     m_settings->beginGroup(group);
     m_settings->setValue(key, value);
     m_settings->endGroup();
     needSync = true;
 }
 
-void Config::setConfigList(const QString &group, const QStringList &keys, const QVariantList &values)
+void Config::storeRemove(const QString &group, const QString &key)
 {
-    m_settings->beginGroup(group);
-    for (int i = 0; i < keys.length(); ++i) {
-        m_settings->setValue(keys.value(i), values.value(i));
+    if (isLayoutGroup(group)) {
+        m_layoutStore->remove(group, key);
+        return;
     }
+
+    m_settings->beginGroup(group);
+    m_settings->remove(key);
     m_settings->endGroup();
     needSync = true;
 }
 
+void Config::queueValue(const QString &group, const QString &key, const QVariant &value)
+{
+    ++m_opsReceived;
+    scheduleFlush();
+    stageValue(group, key, value);
+}
+
+void Config::queueRemove(const QString &group, const QString &key)
+{
+    ++m_opsReceived;
+    scheduleFlush();
+    stageRemove(group, key);
+}
+
+// apply to the published state and coalesce with the pending write
+void Config::stageValue(const QString &group, const QString &key, const QVariant &value)
+{
+    m_state.m_groups[group].insert(key, value);
+
+    if (group == groupGeneral && key == keyProfile) {
+        touchProfile(value.toString());
+    }
+
+    auto &pending = m_pending[group];
+    auto write = pending.writes.find(key);
+    if (write == pending.writes.end()) {
+        write = pending.writes.insert(key, PendingWrite());
+        write->stored = !pending.removeAll && storeContains(group, key);
+    }
+    write->value = value;
+    write->remove = false;
+}
+
+void Config::stageRemove(const QString &group, const QString &key)
+{
+    if (key.isEmpty()) {
+        m_state.m_groups.remove(group);
+    } else if (m_state.m_groups.contains(group)) {
+        m_state.m_groups[group].remove(key);
+    }
+
+    auto &pending = m_pending[group];
+    if (key.isEmpty()) {
+        pending.removeAll = true;
+        pending.writes.clear();
+        return;
+    }
+
+    auto write = pending.writes.find(key);
+    if (write == pending.writes.end()) {
+        if (!pending.removeAll && storeContains(group, key)) {
+            write = pending.writes.insert(key, PendingWrite());
+            write->stored = true;
+            write->remove = true;
+        }
+        return;
+    }
+
+    // set then remove of a key the store never had cancels out
+    if (!write->stored) {
+        pending.writes.erase(write);
+        return;
+    }
+    write->value = QVariant();
+    write->remove = true;
+}
+
+void Config::pushLayoutOp(LayoutOp::Type type, ItemHandle item, Coordinate::CoordValue cell)
+{
+    LayoutOp op;
+    op.type = type;
+    op.item = item;
+    op.cell = cell;
+
+    // keep the name resolvable until the Config thread has settled it
+    if (LayoutOp::SetCell == type) {
+        ItemRegistry::instance()->pin(item);
+    }
+    m_layoutOps.push(op);
+}
+
+void Config::commitLayoutOps()
+{
+    if (!m_drainScheduled.exchange(true)) {
+        QMetaObject::invokeMethod(this, "drainLayoutOps", Qt::QueuedConnection);
+    }
+}
+
+// Only the last op per cell is kept, names and keys are built once per
+// flush by settleLayoutCells().
+void Config::drainLayoutOps()
+{
+    // ops pushed from now on need another drain
+    m_drainScheduled = false;
+
+    auto registry = ItemRegistry::instance();
+    LayoutOp op;
+    while (m_layoutOps.pop(op)) {
+        switch (op.type) {
+        case LayoutOp::SelectProfile:
+            // readers switching back to a profile see all of its cells
+            if (op.cell != m_layoutProfile && m_layoutCells.contains(m_layoutProfile)) {
+                settleLayoutCells();
+                publish();
+            }
+            m_layoutProfile = op.cell;
+            continue;
+        case LayoutOp::SetCell:
+        case LayoutOp::RemoveCell: {
+            auto &cells = m_layoutCells[m_layoutProfile].cells;
+            auto cell = cells.find(op.cell);
+            if (cell == cells.end()) {
+                cells.insert(op.cell, op.item);
+            } else {
+                if (*cell != ItemRegistry::InvalidHandle) {
+                    registry->unpin(*cell);
+                }
+                *cell = op.item;
+            }
+            break;
+        }
+        case LayoutOp::RemoveProfile: {
+            auto &layout = m_layoutCells[m_layoutProfile];
+            for (auto item : layout.cells) {
+                if (item != ItemRegistry::InvalidHandle) {
+                    registry->unpin(item);
+                }
+            }
+            layout.cells.clear();
+            layout.removeAll = true;
+            break;
+        }
+        }
+        ++m_opsReceived;
+        scheduleFlush();
+    }
+}
+
+// Turn the drained cells into pending writes of their Position_WxH group.
+void Config::settleLayoutCells()
+{
+    auto registry = ItemRegistry::instance();
+    for (auto layout = m_layoutCells.constBegin(); layout != m_layoutCells.constEnd(); ++layout) {
+        auto size = Coordinate::fromKey(layout.key()).position();
+        auto profile = QString("Position_%1x%2").arg(size.x()).arg(size.y());
+        if (layout->removeAll) {
+            stageRemove(profile, "");
+        }
+        for (auto cell = layout->cells.constBegin(); cell != layout->cells.constEnd(); ++cell) {
+            auto pos = Coordinate::fromKey(cell.key()).position();
+            auto key = QString("%1_%2").arg(pos.x()).arg(pos.y());
+            if (cell.value() == ItemRegistry::InvalidHandle) {
+                stageRemove(profile, key);
+            } else {
+                stageValue(profile, key, registry->localFile(cell.value()));
+                registry->unpin(cell.value());
+            }
+        }
+    }
+    m_layoutCells.clear();
+}
+
+void Config::flush()
+{
+    drainLayoutOps();
+    if (!m_layoutCells.isEmpty()) {
+        settleLayoutCells();
+        publish();
+    }
+    m_flushTimer->stop();
+
+    // held back until enablePersistence()
+    if (!m_persistent) {
+        return;
+    }
+
+    auto received = m_opsReceived - m_flushedReceived;
+    quint64 applied = 0;
+    for (auto group = m_pending.constBegin(); group != m_pending.constEnd(); ++group) {
+        if (group->removeAll) {
+            storeRemove(group.key(), "");
+            ++applied;
+        }
+        for (auto write = group->writes.constBegin(); write != group->writes.constEnd(); ++write) {
+            if (write->remove) {
+                storeRemove(group.key(), write.key());
+            } else {
+                storeValue(group.key(), write.key(), write->value);
+            }
+            ++applied;
+        }
+    }
+    m_pending.clear();
+    m_opsApplied += applied;
+    m_flushedReceived = m_opsReceived;
+
+    if (received) {
+        qDebug() << "config flush" << received << "ops received," << applied << "applied,"
+                 << m_opsReceived.load() << "/" << m_opsApplied.load() << "in total";
+    }
+
+    if (needSync) {
+        needSync = false;
+        // the ini store shares the file, one sync of it is enough
+        if (m_iniLayoutStore) {
+            m_iniLayoutStore->touch();
+        } else {
+            syncSettings();
+        }
+    }
+    syncLayoutStore();
+}
+
+quint64 Config::opsReceived() const
+{
+    return m_opsReceived;
+}
+
+quint64 Config::opsApplied() const
+{
+    return m_opsApplied;
+}
+
+void Config::setConfig(const QString &group, const QString &key, const QVariant &value)
+{
+    queueValue(group, key, value);
+    publish();
+}
+
+void Config::setConfigList(const QString &group, const QStringList &keys, const QVariantList &values)
+{
+    for (int i = 0; i < keys.length(); ++i) {
+        queueValue(group, keys.value(i), values.value(i));
+    }
+    publish();
+}
+
 void Config::removeConfig(const QString &group, const QString &key)
 {
-    m_settings->beginGroup(group);
-    m_settings->remove(key);
-    m_settings->endGroup();
-    needSync = true;
+    queueRemove(group, key);
+    publish();
 }
 
 void Config::removeConfigList(const QString &group, const QStringList &keys)
 {
-    m_settings->beginGroup(group);
     for (int i = 0; i < keys.length(); ++i) {
-        m_settings->remove(keys.value(i));
+        queueRemove(group, keys.value(i));
     }
-    m_settings->endGroup();
-    needSync = true;
+    publish();
 }
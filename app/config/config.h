@@ -10,14 +10,55 @@
 
 #include <QObject>
 #include <QSettings>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
 
 #include "../global/singleton.h"
+#include "atomicfile.h"
+#include "flushstats.h"
+#include "configsnapshot.h"
+#include "layoutopqueue.h"
+
+class QTimer;
+class LayoutStore;
+class IniLayoutStore;
 
 class Config: public QObject, public Singleton<Config>
 {
     Q_OBJECT
 public:
-    QSettings *settings()  {return m_settings;}
+    // Latest published state, pending writes included. Readers on any
+    // thread get an immutable copy and never wait for a flush on the
+    // Config thread, which is the only writer. This is not lock-free:
+    // libstdc++ guards atomic shared_ptr access with a pool of
+    // spinlocks, held for the pointer copy and refcount bump only.
+    // Position profiles are loaded on the Config thread after start, so
+    // snapshot() may lack them at first; value() and groupValues() of a
+    // Position_WxH group wait for that load.
+    std::shared_ptr<const ConfigSnapshot> snapshot() const;
+    QVariant value(const QString &group, const QString &key, const QVariant &defaultValue = QVariant()) const;
+    QVariantMap groupValues(const QString &group) const;
+
+    quint64 opsReceived() const;
+    quint64 opsApplied() const;
+
+    // flush pending writes and wait for them, safe from any thread
+    void flushSync();
+
+    // Nothing reaches the disk until this process owns the desktop
+    // service name: a second instance that quits again must not flush,
+    // migrate or compact the files of the first one.
+    bool isPersistent() const;
+
+    // Position profile edits from the GUI thread, the only producer.
+    // Never blocks; ops are picked up by the Config thread after
+    // commitLayoutOps() and kept per cell until the next flush.
+    void pushLayoutOp(LayoutOp::Type type, ItemHandle item, Coordinate::CoordValue cell);
+    void commitLayoutOps();
 
     static const QString groupGeneral;
     static const QString keyProfile;
@@ -26,6 +67,10 @@ public:
     static const QString keyAutoAlign;
     static const QString keyIconLevel;
     static const QString keyQuickHide;
+    static const QString keyLayoutStorage;
+    static const QString keyDirSync;
+    static const QString keyProfileRetention;
+    static const QString groupProfileUsage;
 
 public slots:
     void setConfig(const QString &group, const QString &key, const QVariant &value);
@@ -33,11 +78,98 @@ public slots:
     void setConfigList(const QString &group, const QStringList &keys, const QVariantList &values);
     void removeConfigList(const QString &group, const QStringList &keys);
 
+    // the service name is ours, write what was held back since start
+    void enablePersistence();
+
+    // apply the coalesced writes of this window and sync the stores
+    void flush();
+    void drainLayoutOps();
+    void collectProfiles();
+
+signals:
+    void persistenceEnabled();
+
 private:
     Q_DISABLE_COPY(Config)
     explicit Config();
     friend Singleton<Config>;
 
-    QSettings   *m_settings = nullptr;
-    bool        needSync    = false;
+    Q_INVOKABLE void loadLayout();
+    void waitLayout() const;
+    void initLayoutStore(const QString &storage, const QString &configDir);
+    void migrateProfiles();
+    void finishMigration();
+    bool isLayoutGroup(const QString &group) const;
+    void scheduleFlush();
+    void syncSettings();
+    void syncLayoutStore();
+
+    bool storeContains(const QString &group, const QString &key) const;
+    void storeValue(const QString &group, const QString &key, const QVariant &value);
+    void storeRemove(const QString &group, const QString &key);
+
+    void queueValue(const QString &group, const QString &key, const QVariant &value);
+    void queueRemove(const QString &group, const QString &key);
+    void stageValue(const QString &group, const QString &key, const QVariant &value);
+    void stageRemove(const QString &group, const QString &key);
+    void settleLayoutCells();
+    void loadState();
+    void publish();
+    void touchProfile(const QString &profile);
+    double probeSettings() const;
+
+    // last write of a key in the flush window, stored tells whether the
+    // key existed before the window so a set/remove pair can be dropped
+    struct PendingWrite {
+        QVariant    value;
+        bool        remove  = false;
+        bool        stored  = false;
+    };
+
+    struct PendingGroup {
+        bool                        removeAll = false;
+        QMap<QString, PendingWrite> writes;
+    };
+
+    QSettings       *m_settings = nullptr;
+    LayoutStore     *m_layoutStore = nullptr;
+    // set when the profiles share m_settings, the store then owns its sync
+    IniLayoutStore  *m_iniLayoutStore = nullptr;
+    QTimer          *m_flushTimer = nullptr;
+    QTimer          *m_profileGcTimer = nullptr;
+    QElapsedTimer   m_dirtySince;
+    bool            needSync    = false;
+    std::atomic<bool>   m_persistent {false};
+    // ini groups copied to the layout store, dropped once it synced
+    QStringList     m_migratedGroups;
+
+    mutable QMutex          m_layoutMutex;
+    mutable QWaitCondition  m_layoutLoaded;
+    std::atomic<bool>       m_layoutReady {false};
+
+    // worker side copy, published as a new snapshot after each change
+    ConfigSnapshot                          m_state;
+    std::shared_ptr<const ConfigSnapshot>   m_snapshot;
+
+    AtomicFile::DirSyncPolicy   m_dirSyncPolicy = AtomicFile::DirSyncOnRename;
+    FlushStats                  m_settingsStats {"config"};
+    FlushStats                  m_layoutStats {"layout store"};
+
+    // drained layout ops of a profile, the last handle per cell, or
+    // InvalidHandle for a removed cell; names are only looked up when
+    // the cells are settled into m_pending
+    struct LayoutCells {
+        bool                                        removeAll = false;
+        QHash<Coordinate::CoordValue, ItemHandle>   cells;
+    };
+
+    QMap<QString, PendingGroup> m_pending;
+    LayoutOpQueue           m_layoutOps;
+    std::atomic<bool>       m_drainScheduled {false};
+    Coordinate::CoordValue  m_layoutProfile = 0;
+    QHash<Coordinate::CoordValue, LayoutCells>  m_layoutCells;
+
+    std::atomic<quint64>    m_opsReceived {0};
+    std::atomic<quint64>    m_opsApplied {0};
+    quint64                 m_flushedReceived = 0;
 };
@@ -0,0 +1,58 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+// Immutable view of every config group at one version.
+// Groups are implicitly shared between consecutive snapshots, so
+// publishing a new one only copies the group that changed.
+class ConfigSnapshot
+{
+public:
+    quint64 version() const
+    {
+        return m_version;
+    }
+
+    bool contains(const QString &group, const QString &key) const
+    {
+        auto values = m_groups.constFind(group);
+        return values != m_groups.constEnd() && values->contains(key);
+    }
+
+    QVariant value(const QString &group, const QString &key,
+                   const QVariant &defaultValue = QVariant()) const
+    {
+        auto values = m_groups.constFind(group);
+        if (values == m_groups.constEnd()) {
+            return defaultValue;
+        }
+        return values->value(key, defaultValue);
+    }
+
+    QVariantMap group(const QString &group) const
+    {
+        return m_groups.value(group);
+    }
+
+    QStringList groups() const
+    {
+        return m_groups.keys();
+    }
+
+private:
+    friend class Config;
+
+    quint64                     m_version = 0;
+    QHash<QString, QVariantMap> m_groups;
+};
@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+#include <QDebug>
+
+// Log2 histograms of flush latency (microseconds) and flushed bytes.
+// Bucket i counts samples in [2^(i-1), 2^i), bucket 0 counts zero.
+class FlushStats
+{
+public:
+    static const int BucketCount = 40;
+
+    explicit FlushStats(const QString &name) : m_name(name) {}
+
+    void record(qint64 nsecs, qint64 bytes)
+    {
+        auto usecs = nsecs / 1000;
+        ++m_latency[bucket(usecs)];
+        ++m_bytes[bucket(bytes)];
+        ++m_count;
+        m_totalUsecs += usecs;
+        m_totalBytes += bytes;
+        m_maxUsecs = qMax(m_maxUsecs, usecs);
+    }
+
+    quint64 count() const
+    {
+        return m_count;
+    }
+
+    void dump() const
+    {
+        if (!m_count) {
+            return;
+        }
+        qDebug() << m_name << "flushes" << m_count
+                 << "avg" << m_totalUsecs / m_count << "us"
+                 << "max" << m_maxUsecs << "us"
+                 << "bytes" << m_totalBytes;
+        qDebug() << m_name << "latency us" << histogram(m_latency);
+        qDebug() << m_name << "bytes" << histogram(m_bytes);
+    }
+
+private:
+    static int bucket(qint64 value)
+    {
+        if (value <= 0) {
+            return 0;
+        }
+        return qMin(BucketCount - 1, 64 - __builtin_clzll(quint64(value)));
+    }
+
+    static QString histogram(const quint64 *buckets)
+    {
+        QStringList items;
+        for (int i = 0; i < BucketCount; ++i) {
+            if (buckets[i]) {
+                auto bound = i ? QString("<%1").arg(quint64(1) << i) : QString("0");
+                items << QString("%1:%2").arg(bound).arg(buckets[i]);
+            }
+        }
+        return items.join(" ");
+    }
+
+    QString m_name;
+    quint64 m_latency[BucketCount] = {};
+    quint64 m_bytes[BucketCount] = {};
+    quint64 m_count         = 0;
+    qint64  m_totalUsecs    = 0;
+    qint64  m_maxUsecs      = 0;
+    qint64  m_totalBytes    = 0;
+};
@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#include "inilayoutstore.h"
+
+#include <QSettings>
+#include <QFileInfo>
+#include <QDebug>
+
+namespace
+{
+const QString positionGroupPrefix = "Position_";
+}
+
+IniLayoutStore::IniLayoutStore(QSettings *settings)
+    : m_settings(settings)
+{
+}
+
+QString IniLayoutStore::name() const
+{
+    return "ini";
+}
+
+bool IniLayoutStore::load()
+{
+    return m_settings->status() == QSettings::NoError;
+}
+
+QStringList IniLayoutStore::profiles() const
+{
+    QStringList profiles;
+    for (auto &group : m_settings->childGroups()) {
+        if (group.startsWith(positionGroupPrefix)) {
+            profiles << group;
+        }
+    }
+    return profiles;
+}
+
+QMap<QString, QString> IniLayoutStore::values(const QString &profile) const
+{
+    QMap<QString, QString> values;
+    m_settings->beginGroup(profile);
+    for (auto &key : m_settings->childKeys()) {
+        values.insert(key, m_settings->value(key).toString());
+    }
+    m_settings->endGroup();
+    return values;
+}
+
+bool IniLayoutStore::contains(const QString &profile, const QString &key) const
+{
+    return m_settings->contains(profile + "/" + key);
+}
+
+void IniLayoutStore::setValue(const QString &profile, const QString &key, const QString &localFile)
+{
+    m_settings->beginGroup(profile);
+    m_settings->setValue(key, localFile);
+    m_settings->endGroup();
+    m_dirty = true;
+}
+
+void IniLayoutStore::remove(const QString &profile, const QString &key)
+{
+    m_settings->beginGroup(profile);
+    m_settings->remove(key);
+    m_settings->endGroup();
+    m_dirty = true;
+}
+
+void IniLayoutStore::touch()
+{
+    m_dirty = true;
+}
+
+bool IniLayoutStore::isDirty() const
+{
+    return m_dirty;
+}
+
+// QSettings already replaces the file through a temp file and a rename,
+// make the new content and the rename durable as well
+bool IniLayoutStore::sync()
+{
+    if (!m_dirty) {
+        return true;
+    }
+    m_dirty = false;
+
+    m_settings->sync();
+    if (m_settings->status() != QSettings::NoError) {
+        qWarning() << "sync config failed" << m_settings->fileName() << m_settings->status();
+        return false;
+    }
+
+    QFileInfo configFile(m_settings->fileName());
+    AtomicFile::syncFile(configFile.absoluteFilePath());
+    if (m_dirSyncPolicy != AtomicFile::DirSyncNever) {
+        AtomicFile::syncDirectory(configFile.absolutePath());
+    }
+    m_bytesWritten += configFile.size();
+    return true;
+}
+
+quint64 IniLayoutStore::bytesWritten() const
+{
+    return m_bytesWritten;
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include "layoutstore.h"
+
+class QSettings;
+
+// Profiles as groups of the main conf file, the historical format.
+// Every sync rewrites the whole file.
+class IniLayoutStore : public LayoutStore
+{
+public:
+    explicit IniLayoutStore(QSettings *settings);
+
+    QString name() const override;
+    bool load() override;
+
+    QStringList profiles() const override;
+    QMap<QString, QString> values(const QString &profile) const override;
+    bool contains(const QString &profile, const QString &key) const override;
+
+    void setValue(const QString &profile, const QString &key, const QString &localFile) override;
+    void remove(const QString &profile, const QString &key) override;
+
+    // the non profile groups of the shared file changed, sync it too
+    void touch();
+
+    bool isDirty() const override;
+    bool sync() override;
+    quint64 bytesWritten() const override;
+
+private:
+    QSettings   *m_settings     = nullptr;
+    bool        m_dirty         = false;
+    quint64     m_bytesWritten  = 0;
+};
@@ -0,0 +1,362 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#include "layoutjournal.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <string.h>
+#include <unistd.h>
+
+namespace
+{
+const char JournalMagic[4] = {'D', 'D', 'L', 'J'};
+const quint8 JournalVersion = 1;
+const int HeaderSize = 8;
+
+// op, group length, key length, value length
+const int RecordHeadSize = 1 + 2 + 2 + 4;
+const int RecordTailSize = 2;
+
+const qint64 CompactThreshold = 256 * 1024;
+
+enum JournalOp {
+    OpSet = 1,
+    OpRemove = 2,
+    OpRemoveGroup = 3,
+};
+
+inline void putUInt16(QByteArray &buffer, quint16 value)
+{
+    buffer.append(static_cast<char>(value & 0xff));
+    buffer.append(static_cast<char>((value >> 8) & 0xff));
+}
+
+inline void putUInt32(QByteArray &buffer, quint32 value)
+{
+    putUInt16(buffer, value & 0xffff);
+    putUInt16(buffer, (value >> 16) & 0xffff);
+}
+
+inline quint16 getUInt16(const uchar *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+inline quint32 getUInt32(const uchar *data)
+{
+    return getUInt16(data) | (static_cast<quint32>(getUInt16(data + 2)) << 16);
+}
+
+QByteArray journalHeader()
+{
+    QByteArray header(JournalMagic, sizeof(JournalMagic));
+    header.append(static_cast<char>(JournalVersion));
+    header.append(QByteArray(HeaderSize - header.size(), '\0'));
+    return header;
+}
+
+void encodeRecord(QByteArray &buffer, quint8 op, const QString &group,
+                  const QString &key, const QString &value)
+{
+    auto groupData = group.toUtf8();
+    auto keyData = key.toUtf8();
+    auto valueData = value.toUtf8();
+
+    auto start = buffer.size();
+    buffer.append(static_cast<char>(op));
+    putUInt16(buffer, groupData.size());
+    putUInt16(buffer, keyData.size());
+    putUInt32(buffer, valueData.size());
+    buffer.append(groupData);
+    buffer.append(keyData);
+    buffer.append(valueData);
+    putUInt16(buffer, qChecksum(buffer.constData() + start, buffer.size() - start));
+}
+}
+
+LayoutJournal::LayoutJournal(const QString &path)
+    : m_path(path)
+{
+}
+
+QString LayoutJournal::name() const
+{
+    return "layout journal";
+}
+
+const QString &LayoutJournal::path() const
+{
+    return m_path;
+}
+
+bool LayoutJournal::load()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_groups.clear();
+    m_pending.clear();
+    m_fileSize = 0;
+    m_truncate = false;
+
+    // read only, whatever must be cut off is cut before the next append
+    QFile file(m_path);
+    if (!file.exists()) {
+        return true;
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "open layout journal failed" << m_path << file.errorString();
+        return false;
+    }
+
+    auto size = file.size();
+    if (size < HeaderSize) {
+        m_truncate = size > 0;
+        return true;
+    }
+
+    auto data = file.map(0, size);
+    if (!data) {
+        qWarning() << "map layout journal failed" << m_path << file.errorString();
+        return false;
+    }
+
+    if (0 != memcmp(data, JournalMagic, sizeof(JournalMagic)) || data[4] != JournalVersion) {
+        qWarning() << "unknown layout journal format, discard" << m_path;
+        file.unmap(data);
+        m_truncate = true;
+        return true;
+    }
+
+    auto validSize = HeaderSize + replay(data + HeaderSize, size - HeaderSize);
+    file.unmap(data);
+
+    // a torn tail left by an interrupted append
+    if (validSize < size) {
+        qWarning() << "truncate layout journal from" << size << "to" << validSize;
+        m_truncate = true;
+    }
+    m_fileSize = validSize;
+
+    qDebug() << "load layout journal" << m_path << m_fileSize << "bytes"
+             << m_groups.size() << "groups in" << timer.elapsed() << "ms";
+    return true;
+}
+
+qint64 LayoutJournal::replay(const uchar *data, qint64 size)
+{
+    qint64 offset = 0;
+    while (offset + RecordHeadSize + RecordTailSize <= size) {
+        auto record = data + offset;
+        auto op = record[0];
+        auto groupSize = getUInt16(record + 1);
+        auto keySize = getUInt16(record + 3);
+        auto valueSize = getUInt32(record + 5);
+
+        qint64 bodySize = RecordHeadSize + groupSize + keySize + valueSize;
+        if (offset + bodySize + RecordTailSize > size) {
+            break;
+        }
+
+        auto checksum = getUInt16(record + bodySize);
+        if (checksum != qChecksum(reinterpret_cast<const char *>(record), bodySize)) {
+            break;
+        }
+
+        auto text = reinterpret_cast<const char *>(record + RecordHeadSize);
+        auto group = QString::fromUtf8(text, groupSize);
+        auto key = QString::fromUtf8(text + groupSize, keySize);
+
+        switch (op) {
+        case OpSet:
+            m_groups[group].insert(key, QString::fromUtf8(text + groupSize + keySize, valueSize));
+            break;
+        case OpRemove:
+            if (m_groups.contains(group)) {
+                m_groups[group].remove(key);
+            }
+            break;
+        case OpRemoveGroup:
+            m_groups.remove(group);
+            break;
+        default:
+            return offset;
+        }
+
+        offset += bodySize + RecordTailSize;
+    }
+    return offset;
+}
+
+void LayoutJournal::append(quint8 op, const QString &group, const QString &key, const QString &value)
+{
+    encodeRecord(m_pending, op, group, key, value);
+}
+
+void LayoutJournal::setValue(const QString &group, const QString &key, const QString &value)
+{
+    m_groups[group].insert(key, value);
+    append(OpSet, group, key, value);
+}
+
+void LayoutJournal::remove(const QString &group, const QString &key)
+{
+    if (key.isEmpty()) {
+        if (m_groups.remove(group)) {
+            append(OpRemoveGroup, group, QString(), QString());
+        }
+        return;
+    }
+
+    if (m_groups.contains(group) && m_groups[group].remove(key)) {
+        append(OpRemove, group, key, QString());
+    }
+}
+
+bool LayoutJournal::contains(const QString &group) const
+{
+    return m_groups.contains(group);
+}
+
+bool LayoutJournal::contains(const QString &group, const QString &key) const
+{
+    auto entries = m_groups.constFind(group);
+    return entries != m_groups.constEnd() && entries->contains(key);
+}
+
+QStringList LayoutJournal::profiles() const
+{
+    return m_groups.keys();
+}
+
+QMap<QString, QString> LayoutJournal::values(const QString &group) const
+{
+    QMap<QString, QString> values;
+    auto entries = m_groups.value(group);
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        values.insert(it.key(), it.value());
+    }
+    return values;
+}
+
+bool LayoutJournal::isDirty() const
+{
+    return !m_pending.isEmpty();
+}
+
+bool LayoutJournal::sync()
+{
+    if (!appendPending()) {
+        return false;
+    }
+    return needCompact() ? compact() : true;
+}
+
+bool LayoutJournal::appendPending()
+{
+    if (m_pending.isEmpty()) {
+        return true;
+    }
+
+    if (m_truncate) {
+        if (!QFile::resize(m_path, m_fileSize)) {
+            qWarning() << "truncate layout journal failed" << m_path;
+            return false;
+        }
+        m_truncate = false;
+    }
+
+    QFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "open layout journal failed" << m_path << file.errorString();
+        return false;
+    }
+
+    QByteArray data;
+    auto created = (0 == file.size());
+    if (created) {
+        data = journalHeader();
+    }
+    data.append(m_pending);
+
+    if (file.write(data) != data.size() || !file.flush()) {
+        qWarning() << "append layout journal failed" << m_path << file.errorString();
+        return false;
+    }
+    ::fdatasync(file.handle());
+
+    if (m_dirSyncPolicy == AtomicFile::DirSyncAlways
+            || (created && m_dirSyncPolicy == AtomicFile::DirSyncOnRename)) {
+        AtomicFile::syncDirectory(QFileInfo(m_path).absolutePath());
+    }
+
+    m_fileSize = file.size();
+    m_bytesWritten += data.size();
+    m_pending.clear();
+    return true;
+}
+
+bool LayoutJournal::needCompact() const
+{
+    if (m_fileSize < CompactThreshold) {
+        return false;
+    }
+    return m_fileSize > 2 * liveSize();
+}
+
+bool LayoutJournal::compact()
+{
+    QByteArray data = journalHeader();
+    for (auto group = m_groups.constBegin(); group != m_groups.constEnd(); ++group) {
+        for (auto it = group.value().constBegin(); it != group.value().constEnd(); ++it) {
+            encodeRecord(data, OpSet, group.key(), it.key(), it.value());
+        }
+    }
+
+    if (!AtomicFile::write(m_path, data, m_dirSyncPolicy)) {
+        qWarning() << "compact layout journal failed" << m_path;
+        return false;
+    }
+
+    qDebug() << "compact layout journal" << m_fileSize << "->" << data.size() << "bytes";
+
+    // pending records are already part of the live state
+    m_pending.clear();
+    m_truncate = false;
+    m_fileSize = data.size();
+    m_bytesWritten += data.size();
+    return true;
+}
+
+qint64 LayoutJournal::fileSize() const
+{
+    return m_fileSize;
+}
+
+qint64 LayoutJournal::liveSize() const
+{
+    qint64 size = HeaderSize;
+    for (auto group = m_groups.constBegin(); group != m_groups.constEnd(); ++group) {
+        auto groupSize = group.key().toUtf8().size();
+        for (auto it = group.value().constBegin(); it != group.value().constEnd(); ++it) {
+            size += RecordHeadSize + RecordTailSize + groupSize
+                    + it.key().toUtf8().size() + it.value().toUtf8().size();
+        }
+    }
+    return size;
+}
+
+quint64 LayoutJournal::bytesWritten() const
+{
+    return m_bytesWritten;
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+
+#include "layoutstore.h"
+
+// Append-only binary log of position profile edits.
+// Every set/remove is appended as one small record, so moving an icon
+// costs a few dozen bytes instead of rewriting the whole conf file. The
+// file is memory mapped and replayed on load, and rewritten from the live
+// state once it grows past the compaction threshold.
+class LayoutJournal : public LayoutStore
+{
+public:
+    explicit LayoutJournal(const QString &path);
+
+    QString name() const override;
+    const QString &path() const;
+    bool load() override;
+
+    void setValue(const QString &group, const QString &key, const QString &value) override;
+    // an empty key removes the whole group, like QSettings::remove("")
+    void remove(const QString &group, const QString &key) override;
+
+    bool contains(const QString &group) const;
+    bool contains(const QString &group, const QString &key) const override;
+    QStringList profiles() const override;
+    QMap<QString, QString> values(const QString &group) const override;
+
+    bool isDirty() const override;
+    // append the pending records, and compact once the file has grown
+    bool sync() override;
+
+    bool needCompact() const;
+    bool compact();
+
+    qint64 fileSize() const;
+    qint64 liveSize() const;
+    quint64 bytesWritten() const override;
+
+private:
+    bool appendPending();
+    void append(quint8 op, const QString &group, const QString &key, const QString &value);
+    qint64 replay(const uchar *data, qint64 size);
+
+    QString                                     m_path;
+    QHash<QString, QHash<QString, QString> >    m_groups;
+
+    QByteArray  m_pending;
+    qint64      m_fileSize      = 0;
+    // the file holds a torn or unknown tail past m_fileSize
+    bool        m_truncate      = false;
+    quint64     m_bytesWritten  = 0;
+};
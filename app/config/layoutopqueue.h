@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+
+#include "../global/coorinate.h"
+#include "../model/itemregistry.h"
+
+// One position profile edit, 16 bytes with no heap data.
+struct LayoutOp {
+    enum Type : quint8 {
+        SelectProfile,  // cell holds the grid size (w, h) of the profile
+        SetCell,        // item goes to cell, item is pinned by the producer
+        RemoveCell,
+        RemoveProfile,
+    };
+
+    quint8                  type    = SelectProfile;
+    ItemHandle              item    = ItemRegistry::InvalidHandle;
+    Coordinate::CoordValue  cell    = 0;
+};
+
+// Unbounded single producer / single consumer queue of layout ops.
+// The GUI thread pushes, the Config thread pops; each side only writes
+// its own end, so neither ever takes a lock or waits for the other.
+// Ops are stored in fixed segments, a full segment is chained to the
+// next one and the consumer hands drained segments back for reuse, so
+// steady state traffic does not allocate.
+class LayoutOpQueue
+{
+public:
+    static const quint32 SegmentSize = 4096;
+
+    LayoutOpQueue()
+    {
+        m_head = new Segment;
+        m_tail = m_head;
+    }
+
+    ~LayoutOpQueue()
+    {
+        while (m_head) {
+            auto next = m_head->next.load(std::memory_order_relaxed);
+            delete m_head;
+            m_head = next;
+        }
+        delete m_spare.load(std::memory_order_relaxed);
+    }
+
+    // producer only
+    void push(const LayoutOp &op)
+    {
+        auto count = m_tail->count.load(std::memory_order_relaxed);
+        if (count == SegmentSize) {
+            auto segment = m_spare.exchange(nullptr, std::memory_order_acquire);
+            if (segment) {
+                segment->count.store(0, std::memory_order_relaxed);
+                segment->next.store(nullptr, std::memory_order_relaxed);
+            } else {
+                segment = new Segment;
+            }
+            m_tail->next.store(segment, std::memory_order_release);
+            m_tail = segment;
+            count = 0;
+        }
+        m_tail->ops[count] = op;
+        m_tail->count.store(count + 1, std::memory_order_release);
+    }
+
+    // consumer only, false when the queue is empty
+    bool pop(LayoutOp &op)
+    {
+        if (m_read == SegmentSize) {
+            auto next = m_head->next.load(std::memory_order_acquire);
+            if (!next) {
+                return false;
+            }
+            // keep one drained segment for the producer, free the rest
+            delete m_spare.exchange(m_head, std::memory_order_acq_rel);
+            m_head = next;
+            m_read = 0;
+        }
+        if (m_read == m_head->count.load(std::memory_order_acquire)) {
+            return false;
+        }
+        op = m_head->ops[m_read++];
+        return true;
+    }
+
+private:
+    Q_DISABLE_COPY(LayoutOpQueue)
+
+    struct Segment {
+        std::atomic<quint32>    count {0};
+        std::atomic<Segment *>  next {nullptr};
+        LayoutOp                ops[SegmentSize];
+    };
+
+    // keep the two ends on their own cache lines
+    alignas(64) Segment                 *m_head = nullptr;
+    quint32                             m_read = 0;
+    alignas(64) Segment                 *m_tail = nullptr;
+    alignas(64) std::atomic<Segment *>  m_spare {nullptr};
+};
@@ -0,0 +1,47 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+
+#include "atomicfile.h"
+
+// Backend holding the Position_WxH profiles, each a map of "x_y" cell
+// keys to the local file placed there. Config owns one store and calls
+// it from its own thread only.
+class LayoutStore
+{
+public:
+    virtual ~LayoutStore() {}
+
+    virtual QString name() const = 0;
+    virtual bool load() = 0;
+
+    virtual QStringList profiles() const = 0;
+    virtual QMap<QString, QString> values(const QString &profile) const = 0;
+    virtual bool contains(const QString &profile, const QString &key) const = 0;
+
+    virtual void setValue(const QString &profile, const QString &key, const QString &localFile) = 0;
+    // an empty key removes the whole profile
+    virtual void remove(const QString &profile, const QString &key) = 0;
+
+    virtual bool isDirty() const = 0;
+    virtual bool sync() = 0;
+    virtual quint64 bytesWritten() const = 0;
+
+    void setDirSyncPolicy(AtomicFile::DirSyncPolicy policy)
+    {
+        m_dirSyncPolicy = policy;
+    }
+
+protected:
+    AtomicFile::DirSyncPolicy m_dirSyncPolicy = AtomicFile::DirSyncOnRename;
+};
@@ -0,0 +1,303 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#include "xattrlayoutstore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/xattr.h>
+
+namespace
+{
+const QByteArray attrPrefix = "user.dde-desktop.";
+}
+
+XattrLayoutStore::XattrLayoutStore(const QString &rootPath, LayoutStore *fallback)
+    : m_rootPath(rootPath), m_fallback(fallback)
+{
+}
+
+XattrLayoutStore::~XattrLayoutStore()
+{
+    delete m_fallback;
+}
+
+QString XattrLayoutStore::name() const
+{
+    return "xattr";
+}
+
+bool XattrLayoutStore::load()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_profiles.clear();
+    m_dirty.clear();
+    m_fallbackFiles.clear();
+
+    QDir root(m_rootPath);
+    auto filter = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System;
+    for (auto &name : root.entryList(filter)) {
+        loadFile(root.absoluteFilePath(name));
+    }
+    loadFallback();
+
+    qDebug() << "load layout xattrs of" << m_rootPath << m_profiles.size() << "profiles in"
+             << timer.elapsed() << "ms";
+    return true;
+}
+
+void XattrLayoutStore::loadFile(const QString &localFile)
+{
+    auto path = QFile::encodeName(localFile);
+    auto size = ::listxattr(path.constData(), nullptr, 0);
+    if (size <= 0) {
+        return;
+    }
+
+    QByteArray names(static_cast<int>(size), '\0');
+    size = ::listxattr(path.constData(), names.data(), names.size());
+    if (size <= 0) {
+        return;
+    }
+
+    for (auto &attr : names.left(static_cast<int>(size)).split('\0')) {
+        if (!attr.startsWith(attrPrefix)) {
+            continue;
+        }
+
+        char value[64];
+        auto length = ::getxattr(path.constData(), attr.constData(), value, sizeof(value));
+        if (length <= 0) {
+            continue;
+        }
+
+        auto profile = QString::fromLatin1(attr.mid(attrPrefix.length()));
+        auto key = QString::fromLatin1(value, static_cast<int>(length));
+        auto &entries = m_profiles[profile];
+        entries.cells.insert(key, localFile);
+        entries.files.insert(localFile, key);
+    }
+}
+
+// cells of the files that could not take an attribute, newer than any
+// attribute such a file may still carry
+void XattrLayoutStore::loadFallback()
+{
+    if (!m_fallback->load()) {
+        qWarning() << "load layout fallback" << m_fallback->name() << "failed";
+        return;
+    }
+
+    auto profiles = m_fallback->profiles();
+    for (auto &profile : profiles) {
+        for (auto &localFile : m_fallback->values(profile)) {
+            m_fallbackFiles.insert(localFile);
+        }
+    }
+    if (m_fallbackFiles.isEmpty()) {
+        return;
+    }
+
+    // drop whatever attribute such a file carried before it moved over
+    for (auto it = m_profiles.begin(); it != m_profiles.end(); ++it) {
+        for (auto &localFile : m_fallbackFiles) {
+            auto key = it->files.take(localFile);
+            if (!key.isEmpty()) {
+                it->cells.remove(key);
+            }
+        }
+    }
+
+    for (auto &profile : profiles) {
+        auto &entries = m_profiles[profile];
+        auto values = m_fallback->values(profile);
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+            auto oldFile = entries.cells.value(it.key());
+            if (!oldFile.isEmpty()) {
+                entries.files.remove(oldFile);
+            }
+            entries.cells.insert(it.key(), it.value());
+            entries.files.insert(it.value(), it.key());
+        }
+    }
+}
+
+QStringList XattrLayoutStore::profiles() const
+{
+    return m_profiles.keys();
+}
+
+QMap<QString, QString> XattrLayoutStore::values(const QString &profile) const
+{
+    QMap<QString, QString> values;
+    auto entries = m_profiles.value(profile);
+    for (auto it = entries.cells.constBegin(); it != entries.cells.constEnd(); ++it) {
+        values.insert(it.key(), it.value());
+    }
+    return values;
+}
+
+bool XattrLayoutStore::contains(const QString &profile, const QString &key) const
+{
+    auto entries = m_profiles.constFind(profile);
+    return entries != m_profiles.constEnd() && entries->cells.contains(key);
+}
+
+void XattrLayoutStore::setValue(const QString &profile, const QString &key, const QString &localFile)
+{
+    auto &entries = m_profiles[profile];
+
+    // a file has one cell per profile, and a cell one file
+    auto oldKey = entries.files.value(localFile);
+    if (!oldKey.isEmpty() && oldKey != key) {
+        entries.cells.remove(oldKey);
+        if (m_fallbackFiles.contains(localFile)) {
+            m_fallback->remove(profile, oldKey);
+        }
+    }
+    auto oldFile = entries.cells.value(key);
+    if (!oldFile.isEmpty() && oldFile != localFile) {
+        entries.files.remove(oldFile);
+        if (!m_fallbackFiles.contains(oldFile)) {
+            m_dirty.insert(qMakePair(profile, oldFile));
+        } else if (!m_fallbackFiles.contains(localFile)) {
+            m_fallback->remove(profile, key);
+        }
+    }
+
+    entries.cells.insert(key, localFile);
+    entries.files.insert(localFile, key);
+    if (m_fallbackFiles.contains(localFile)) {
+        m_fallback->setValue(profile, key, localFile);
+    } else {
+        m_dirty.insert(qMakePair(profile, localFile));
+    }
+}
+
+void XattrLayoutStore::remove(const QString &profile, const QString &key)
+{
+    if (!m_profiles.contains(profile)) {
+        return;
+    }
+
+    auto &entries = m_profiles[profile];
+    if (key.isEmpty()) {
+        for (auto &localFile : entries.files.keys()) {
+            if (!m_fallbackFiles.contains(localFile)) {
+                m_dirty.insert(qMakePair(profile, localFile));
+            }
+        }
+        m_fallback->remove(profile, QString());
+        m_profiles.remove(profile);
+        return;
+    }
+
+    auto localFile = entries.cells.take(key);
+    if (localFile.isEmpty()) {
+        return;
+    }
+    entries.files.remove(localFile);
+    if (m_fallbackFiles.contains(localFile)) {
+        m_fallback->remove(profile, key);
+    } else {
+        m_dirty.insert(qMakePair(profile, localFile));
+    }
+}
+
+bool XattrLayoutStore::isDirty() const
+{
+    return !m_dirty.isEmpty() || m_fallback->isDirty();
+}
+
+bool XattrLayoutStore::sync()
+{
+    auto ok = true;
+    for (auto &entry : m_dirty) {
+        // moved over by an earlier entry of this sync
+        if (m_fallbackFiles.contains(entry.second)) {
+            continue;
+        }
+        if (!writeFile(entry.first, entry.second)) {
+            ok = false;
+        }
+    }
+    m_dirty.clear();
+
+    if (m_fallback->isDirty()) {
+        m_fallback->setDirSyncPolicy(m_dirSyncPolicy);
+        ok &= m_fallback->sync();
+    }
+    return ok;
+}
+
+// keep every cell of the file in the fallback store from now on
+void XattrLayoutStore::moveToFallback(const QString &localFile)
+{
+    m_fallbackFiles.insert(localFile);
+    for (auto it = m_profiles.constBegin(); it != m_profiles.constEnd(); ++it) {
+        auto key = it->files.value(localFile);
+        if (!key.isEmpty()) {
+            m_fallback->setValue(it.key(), key, localFile);
+        }
+    }
+}
+
+// write the current cell of the file, or drop the attribute if it has none
+bool XattrLayoutStore::writeFile(const QString &profile, const QString &localFile)
+{
+    auto path = QFile::encodeName(localFile);
+    auto attr = attrPrefix + profile.toLatin1();
+    auto key = m_profiles.value(profile).files.value(localFile).toLatin1();
+
+    int ret;
+    if (key.isEmpty()) {
+        ret = ::removexattr(path.constData(), attr.constData());
+        if (0 != ret && ENODATA == errno) {
+            return true;
+        }
+    } else {
+        ret = ::setxattr(path.constData(), attr.constData(), key.constData(), key.size(), 0);
+        m_bytesWritten += key.size();
+    }
+
+    if (0 != ret) {
+        // the file is gone, nothing to keep
+        if (ENOENT == errno) {
+            return false;
+        }
+
+        // a filesystem without user xattrs, or a link to a file we may
+        // not write: keep the cell elsewhere instead of losing it
+        if (ENOTSUP == errno && !m_unsupported) {
+            m_unsupported = true;
+            qWarning() << "user xattrs not supported for" << localFile;
+        } else if (ENOTSUP != errno) {
+            qWarning() << "write layout xattr failed" << localFile << strerror(errno)
+                       << ", keep its cells in" << m_fallback->name();
+        }
+        moveToFallback(localFile);
+        return true;
+    }
+
+    if (m_dirSyncPolicy == AtomicFile::DirSyncAlways) {
+        AtomicFile::syncFile(localFile);
+    }
+    return true;
+}
+
+quint64 XattrLayoutStore::bytesWritten() const
+{
+    return m_bytesWritten + m_fallback->bytesWritten();
+}
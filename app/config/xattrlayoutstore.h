@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QHash>
+#include <QSet>
+
+#include "layoutstore.h"
+
+// Keeps each file's cell in a user.dde-desktop.<profile> extended
+// attribute of the file itself, so moving one icon touches one inode
+// instead of rewriting a shared file. Loading scans the desktop folder.
+// The attribute calls follow symlinks, so a launcher linked to a file we
+// may not write, say in /usr/share/applications, cannot hold one; such
+// files keep their cells in the fallback store, which is read on load.
+class XattrLayoutStore : public LayoutStore
+{
+public:
+    // takes ownership of fallback
+    XattrLayoutStore(const QString &rootPath, LayoutStore *fallback);
+    ~XattrLayoutStore() override;
+
+    QString name() const override;
+    bool load() override;
+
+    QStringList profiles() const override;
+    QMap<QString, QString> values(const QString &profile) const override;
+    bool contains(const QString &profile, const QString &key) const override;
+
+    void setValue(const QString &profile, const QString &key, const QString &localFile) override;
+    void remove(const QString &profile, const QString &key) override;
+
+    bool isDirty() const override;
+    bool sync() override;
+    quint64 bytesWritten() const override;
+
+private:
+    struct Profile {
+        QHash<QString, QString> cells;  // cell key -> local file
+        QHash<QString, QString> files;  // local file -> cell key
+    };
+
+    void loadFile(const QString &localFile);
+    void loadFallback();
+    bool writeFile(const QString &profile, const QString &localFile);
+    void moveToFallback(const QString &localFile);
+
+    QString                     m_rootPath;
+    LayoutStore                 *m_fallback     = nullptr;
+    // files whose cells live in m_fallback instead of an attribute
+    QSet<QString>               m_fallbackFiles;
+    QHash<QString, Profile>     m_profiles;
+    // files whose attribute of a profile must be written or removed
+    QSet<QPair<QString, QString> > m_dirty;
+    quint64                     m_bytesWritten  = 0;
+    bool                        m_unsupported   = false;
+};
@@ -13,23 +13,61 @@
 #include <QApplication>
 #include <QStandardPaths>
 #include <QStyleOptionViewItem>
+#include <QDateTime>
+#include <QVector>
 
 #include <durl.h>
 
 #include "view/canvasgridview.h"
 #include "presenter/apppresenter.h"
+#include "model/itemregistry.h"
+#include "presenter/dfminitializer.h"
+#include "util/dde/ddesession.h"
+#include "util/trace/trace.h"
+
+static const char *readyPhaseName(int phase)
+{
+    switch (phase) {
+    case Desktop::WindowMapped:
+        return "WindowMapped";
+    case Desktop::IconsVisible:
+        return "IconsVisible";
+    case Desktop::FullyInteractive:
+        return "FullyInteractive";
+    default:
+        return "NotReady";
+    }
+}
 
 class DesktopPrivate
 {
 public:
     Presenter        presenter;
     CanvasGridView      screenFrame;
+
+    bool                serviceOwner    = false;
+    bool                sessionRegistered = false;
+    int                 readyPhase      = Desktop::NotReady;
+    qint64              startTime       = 0;
+    // indexed by phase, 0 until reached
+    QVector<qint64>     readyTimestamps = QVector<qint64>(Desktop::FullyInteractive + 1, 0);
 };
 
 Desktop::Desktop()
     : d(new DesktopPrivate)
 {
+    // the trace clock starts as main is entered
+    d->startTime = QDateTime::currentMSecsSinceEpoch() - Trace::now() / 1000;
 
+    connect(&d->screenFrame, &CanvasGridView::windowMapped, this, [ = ]() {
+        setReadyPhase(WindowMapped);
+    }, Qt::QueuedConnection);
+    connect(&d->screenFrame, &CanvasGridView::iconsVisible, this, [ = ]() {
+        setReadyPhase(IconsVisible);
+    }, Qt::QueuedConnection);
+    connect(DFMInitializer::instance(), &DFMInitializer::finished, this, [ = ]() {
+        setReadyPhase(FullyInteractive);
+    }, Qt::QueuedConnection);
 }
 
 Desktop::~Desktop()
@@ -45,6 +83,7 @@ void Desktop::loadData()
 void Desktop::loadView()
 {
     auto desktopPath = QStandardPaths::standardLocations(QStandardPaths::DesktopLocation).first();
+    ItemRegistry::instance()->setRootPath(desktopPath);
     auto desktopUrl = DUrl::fromLocalFile(desktopPath);
     d->screenFrame.setRootUrl(desktopUrl);
 }
@@ -53,3 +92,69 @@ void Desktop::Show()
 {
     d->screenFrame.show();
 }
+
+int Desktop::readyPhase() const
+{
+    return d->readyPhase;
+}
+
+qint64 Desktop::startTime() const
+{
+    return d->startTime;
+}
+
+QVariantMap Desktop::ReadyTimestamps() const
+{
+    QVariantMap timestamps;
+    for (int phase = WindowMapped; phase <= FullyInteractive; ++phase) {
+        if (d->readyTimestamps.at(phase) > 0) {
+            timestamps.insert(readyPhaseName(phase), d->readyTimestamps.at(phase));
+        }
+    }
+    return timestamps;
+}
+
+void Desktop::setReadyPhase(ReadyPhase phase)
+{
+    if (phase <= d->readyPhase) {
+        return;
+    }
+
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    auto mapped = (d->readyPhase < WindowMapped);
+    // a later phase also completes the ones it skipped
+    for (int reached = d->readyPhase + 1; reached <= phase; ++reached) {
+        d->readyTimestamps[reached] = now;
+    }
+    d->readyPhase = phase;
+
+    Trace::instant(readyPhaseName(phase));
+    qDebug() << "desktop ready phase" << readyPhaseName(phase)
+             << "after" << now - d->startTime << "ms";
+
+    // the session manager only waits for the window, not for plugins
+    if (mapped) {
+        registerSession();
+    }
+
+    emit ReadyPhaseChanged(phase, now);
+}
+
+void Desktop::setServiceOwner()
+{
+    d->serviceOwner = true;
+    if (d->readyPhase >= WindowMapped) {
+        registerSession();
+    }
+}
+
+void Desktop::registerSession()
+{
+    if (!d->serviceOwner || d->sessionRegistered) {
+        return;
+    }
+    d->sessionRegistered = true;
+
+    DDE_TRACE_SCOPE("RegisterDdeSession");
+    Dde::Session::RegisterDdeSession();
+}
@@ -12,6 +12,7 @@
 
 #include <QObject>
 #include <QScopedPointer>
+#include <QVariantMap>
 
 #include "global/singleton.h"
 
@@ -25,13 +26,41 @@ class Desktop : public QObject, public Singleton<Desktop>
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", DesktopServiceName)
+    Q_PROPERTY(int ReadyPhase READ readyPhase NOTIFY ReadyPhaseChanged)
+    Q_PROPERTY(qint64 StartTime READ startTime)
 public:
+    // startup phases, each one implies the ones before it
+    enum ReadyPhase {
+        NotReady            = 0,
+        WindowMapped        = 1,
+        IconsVisible        = 2,
+        FullyInteractive    = 3,
+    };
+
     void loadData();
     void loadView();
 
+    // the bus gave us the service name; only then register with the
+    // session, a second instance quits without ever doing so
+    void setServiceOwner();
+
+    int readyPhase() const;
+    // ms since epoch when the process entered main
+    qint64 startTime() const;
+
 public slots:
     void Show();
 
+    // phase name to ms since epoch, for every phase reached so far
+    QVariantMap ReadyTimestamps() const;
+
+signals:
+    void ReadyPhaseChanged(int phase, qint64 timestamp);
+
+private:
+    void setReadyPhase(ReadyPhase phase);
+    void registerSession();
+
 private:
     explicit Desktop();
     ~Desktop();
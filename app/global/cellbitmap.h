@@ -0,0 +1,262 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#pragma once
+
+#include <QtGlobal>
+#include <QVector>
+
+// Occupancy of grid cells, one bit per cell packed into 64-bit words.
+// Scans skip a whole word at a time with count-trailing/leading-zeros,
+// and a "first free" hint keeps repeated takeEmptyPos() calls from
+// rescanning the filled prefix of the grid.
+// A Fenwick tree over the free count of each word answers rank() and
+// select() on free cells in O(log n).
+class CellBitmap
+{
+public:
+    static const int WordBits = 64;
+
+    void resize(int size)
+    {
+        m_size = size;
+        m_words.resize((size + WordBits - 1) / WordBits);
+        clear();
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    int length() const
+    {
+        return m_size;
+    }
+
+    int count() const
+    {
+        return m_count;
+    }
+
+    int freeCount() const
+    {
+        return m_size - m_count;
+    }
+
+    void clear()
+    {
+        m_words.fill(0);
+        m_count = 0;
+        m_freeHint = 0;
+
+        // every cell is free, build the tree in O(words)
+        auto wordCount = m_words.size();
+        m_tree.fill(0, wordCount + 1);
+        for (int i = 1; i <= wordCount; ++i) {
+            auto bits = (i == wordCount) ? m_size - (wordCount - 1) * WordBits : WordBits;
+            m_tree[i] += bits;
+            auto parent = i + (i & -i);
+            if (parent <= wordCount) {
+                m_tree[parent] += m_tree[i];
+            }
+        }
+    }
+
+    // out of range cells read as free, like QVector<bool>::value()
+    bool test(int index) const
+    {
+        if (index < 0 || index >= m_size) {
+            return false;
+        }
+        return m_words[index / WordBits] & bit(index);
+    }
+
+    bool value(int index) const
+    {
+        return test(index);
+    }
+
+    void set(int index)
+    {
+        Q_ASSERT(index >= 0 && index < m_size);
+        auto &word = m_words[index / WordBits];
+        if (!(word & bit(index))) {
+            word |= bit(index);
+            ++m_count;
+            updateFree(index / WordBits, -1);
+        }
+    }
+
+    void reset(int index)
+    {
+        Q_ASSERT(index >= 0 && index < m_size);
+        auto &word = m_words[index / WordBits];
+        if (word & bit(index)) {
+            word &= ~bit(index);
+            --m_count;
+            updateFree(index / WordBits, 1);
+            if (index < m_freeHint) {
+                m_freeHint = index;
+            }
+        }
+    }
+
+    // return -1 if no cell is set
+    int firstSet() const
+    {
+        return nextSet(0);
+    }
+
+    int nextSet(int from) const
+    {
+        if (from < 0) {
+            from = 0;
+        }
+        if (from >= m_size) {
+            return -1;
+        }
+
+        int wordIndex = from / WordBits;
+        quint64 word = m_words[wordIndex] & (~quint64(0) << (from % WordBits));
+        while (true) {
+            if (word) {
+                int index = wordIndex * WordBits + __builtin_ctzll(word);
+                return index < m_size ? index : -1;
+            }
+            if (++wordIndex >= m_words.size()) {
+                return -1;
+            }
+            word = m_words[wordIndex];
+        }
+    }
+
+    int lastSet() const
+    {
+        for (int wordIndex = m_words.size() - 1; wordIndex >= 0; --wordIndex) {
+            auto word = m_words[wordIndex];
+            if (word) {
+                return wordIndex * WordBits + (WordBits - 1 - __builtin_clzll(word));
+            }
+        }
+        return -1;
+    }
+
+    // return -1 if every cell is set
+    int firstClear() const
+    {
+        auto index = nextClear(m_freeHint);
+        m_freeHint = (index < 0) ? m_size : index;
+        return index;
+    }
+
+    int nextClear(int from) const
+    {
+        if (from < 0) {
+            from = 0;
+        }
+        if (from >= m_size) {
+            return -1;
+        }
+
+        int wordIndex = from / WordBits;
+        quint64 word = ~m_words[wordIndex] & (~quint64(0) << (from % WordBits));
+        while (true) {
+            if (word) {
+                int index = wordIndex * WordBits + __builtin_ctzll(word);
+                return index < m_size ? index : -1;
+            }
+            if (++wordIndex >= m_words.size()) {
+                return -1;
+            }
+            word = ~m_words[wordIndex];
+        }
+    }
+
+    // number of free cells before index
+    int rank(int index) const
+    {
+        if (index <= 0) {
+            return 0;
+        }
+        if (index > m_size) {
+            index = m_size;
+        }
+
+        auto wordIndex = index / WordBits;
+        auto free = prefixFree(wordIndex);
+        auto rest = index % WordBits;
+        if (rest) {
+            auto mask = (quint64(1) << rest) - 1;
+            free += rest - __builtin_popcountll(m_words[wordIndex] & mask);
+        }
+        return free;
+    }
+
+    // index of the k-th (0 based) free cell, -1 if there are not so many
+    int select(int k) const
+    {
+        if (k < 0 || k >= freeCount()) {
+            return -1;
+        }
+
+        auto wordCount = m_words.size();
+        auto step = 1;
+        while (step * 2 <= wordCount) {
+            step *= 2;
+        }
+
+        int wordIndex = 0;
+        for (; step > 0; step /= 2) {
+            auto next = wordIndex + step;
+            if (next <= wordCount && m_tree[next] <= k) {
+                wordIndex = next;
+                k -= m_tree[next];
+            }
+        }
+
+        // bits past m_size are never counted as free, and they sit above
+        // every valid bit of the word, so the k-th zero is a real cell
+        auto freeBits = ~m_words[wordIndex];
+        for (int i = 0; i < k; ++i) {
+            freeBits &= freeBits - 1;
+        }
+        return wordIndex * WordBits + __builtin_ctzll(freeBits);
+    }
+
+private:
+    static inline quint64 bit(int index)
+    {
+        return quint64(1) << (index % WordBits);
+    }
+
+    void updateFree(int wordIndex, int delta)
+    {
+        for (int i = wordIndex + 1; i < m_tree.size(); i += i & -i) {
+            m_tree[i] += delta;
+        }
+    }
+
+    // free cells in words [0, wordCount)
+    int prefixFree(int wordCount) const
+    {
+        int free = 0;
+        for (int i = wordCount; i > 0; i -= i & -i) {
+            free += m_tree[i];
+        }
+        return free;
+    }
+
+    QVector<quint64>    m_words;
+    QVector<int>        m_tree;     // 1 based Fenwick tree of free cells per word
+    int                 m_size      = 0;
+    int                 m_count     = 0;
+    // no free cell exists below this index
+    mutable int         m_freeHint  = 0;
+};
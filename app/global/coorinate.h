@@ -11,10 +11,19 @@
 
 #include <QtGlobal>
 #include <QPoint>
+#include <QHash>
 
 class Coordinate
 {
 public:
+    typedef quint64 CoordValue;
+
+    Coordinate()
+    {
+        d.x = 0;
+        d.y = 0;
+    }
+
     Coordinate(int _x, int _y)
     {
         d.x = _x;
@@ -27,11 +36,35 @@ public:
         d.y = pos.y();
     }
 
-    QPoint position()
+    QPoint position() const
     {
         return QPoint(d.x, d.y);
     }
 
+    // pack x into the high word so that keys sort column by column,
+    // the same order as the cell index used by GridManager
+    CoordValue key() const
+    {
+        return (static_cast<CoordValue>(static_cast<quint32>(d.x)) << 32)
+               | static_cast<quint32>(d.y);
+    }
+
+    static Coordinate fromKey(CoordValue key)
+    {
+        return Coordinate(static_cast<qint32>(key >> 32),
+                          static_cast<qint32>(key & 0xffffffff));
+    }
+
+    bool operator==(const Coordinate &other) const
+    {
+        return d.x == other.d.x && d.y == other.d.y;
+    }
+
+    bool operator!=(const Coordinate &other) const
+    {
+        return !(*this == other);
+    }
+
     Coordinate moveLeft(int offset = 1) const
     {
         return Coordinate(d.x - offset, d.y);
@@ -63,3 +96,8 @@ private:
 
     CoordinateData  d;
 };
+
+inline uint qHash(const Coordinate &coord, uint seed = 0)
+{
+    return qHash(coord.key(), seed);
+}
@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Unbounded multiple producer / single consumer queue.
+// Producers link a node with one atomic exchange and never wait on each
+// other or on the consumer; only the consumer frees nodes. A pop racing
+// with a half linked push reports empty, the value shows up on the next
+// pop.
+template <class T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : m_head(&m_stub), m_tail(&m_stub)
+    {
+        m_stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {
+        }
+    }
+
+    // any thread
+    void push(T value)
+    {
+        auto node = new Node;
+        node->value = std::move(value);
+        node->next.store(nullptr, std::memory_order_relaxed);
+        link(node);
+    }
+
+    // consumer only, false when empty
+    bool pop(T &value)
+    {
+        auto tail = m_tail;
+        auto next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (!next) {
+                return false;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            m_tail = next;
+            value = std::move(tail->value);
+            delete tail;
+            return true;
+        }
+
+        // a producer has swapped the head but not linked its node yet
+        if (tail != m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        // tail is the last node, put the stub behind it to detach it
+        m_stub.next.store(nullptr, std::memory_order_relaxed);
+        link(&m_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            m_tail = next;
+            value = std::move(tail->value);
+            delete tail;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    struct Node {
+        std::atomic<Node *>     next;
+        T                       value;
+    };
+
+    void link(Node *node)
+    {
+        auto prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    alignas(64) std::atomic<Node *>     m_head;
+    alignas(64) Node                    *m_tail;
+    Node                                m_stub;
+};
@@ -10,26 +10,78 @@
 #include <QDebug>
 #include <QDBusError>
 #include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
 #include <QThreadPool>
+#include <QTimer>
 
 #include <DLog>
 #include <DApplication>
 
 #include <dfmglobal.h>
 
-#include "util/dde/ddesession.h"
+#include "util/trace/trace.h"
 
 #include "config/config.h"
+#include "presenter/dfminitializer.h"
 #include "desktop.h"
 
 using namespace Dtk::Util;
 using namespace Dtk::Widget;
 
+// RequestName flags and replies of org.freedesktop.DBus
+static const uint DBusNameFlagDoNotQueue        = 0x4;
+static const uint DBusRequestNamePrimaryOwner   = 1;
+static const uint DBusRequestNameAlreadyOwner   = 4;
+
+// Ask the bus for our name without waiting for the answer, the canvas is
+// built while the request is in flight. Quit if another desktop owns it.
+static void requestServiceName(QDBusConnection &conn)
+{
+    auto message = QDBusMessage::createMethodCall("org.freedesktop.DBus",
+                   "/org/freedesktop/DBus",
+                   "org.freedesktop.DBus",
+                   "RequestName");
+    message << QString(DesktopServiceName) << DBusNameFlagDoNotQueue;
+
+    auto begin = Trace::now();
+    auto watcher = new QDBusPendingCallWatcher(conn.asyncCall(message), qApp);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+    qApp, [ = ](QDBusPendingCallWatcher * call) {
+        Trace::complete("RequestName", begin, Trace::now() - begin);
+        call->deleteLater();
+
+        QDBusPendingReply<uint> reply = *call;
+        if (reply.isError()) {
+            qDebug() << "registerService Failed" << reply.error();
+            qApp->exit(0x0002);
+            return;
+        }
+
+        auto result = reply.value();
+        if (result != DBusRequestNamePrimaryOwner && result != DBusRequestNameAlreadyOwner) {
+            qDebug() << "registerService Failed, service exist" << result;
+            qApp->exit(0x0002);
+            return;
+        }
+        qDebug() << "registerService" << DesktopServiceName << "acquired";
+
+        // from now on this is the desktop, it may write and join the session
+        QMetaObject::invokeMethod(Config::instance(), "enablePersistence", Qt::QueuedConnection);
+        Desktop::instance()->setServiceOwner();
+    });
+}
+
 int main(int argc, char *argv[])
 {
+    Trace::init();
+
     DApplication::loadDXcbPlugin();
 
+    auto appBegin = Trace::now();
     DApplication app(argc, argv);
+    Trace::complete("DApplication", appBegin, Trace::now() - appBegin);
 
     app.setOrganizationName("deepin");
     app.setApplicationName("dde-desktop");
@@ -43,39 +95,65 @@ int main(int argc, char *argv[])
 
     app.loadTranslator();
 
+    if (Trace::isEnabled()) {
+        // write once startup has settled, and again with everything at exit
+        QTimer::singleShot(10000, []() {
+            Trace::flush();
+        });
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
+            Trace::flush();
+        });
+    }
+
     qDebug() << "start "<< app.applicationName() << app.applicationVersion();
 
     QDBusConnection conn = QDBusConnection::sessionBus();
 
-    if (!conn.registerService(DesktopServiceName)) {
-        qDebug() << "registerService Failed, maybe service exist" << conn.lastError();
-        exit(0x0002);
+    // registerObject is local to the connection, export the object before
+    // the name so no caller ever sees the name without it
+    {
+        DDE_TRACE_SCOPE("registerObject");
+        if (!conn.registerObject(DesktopServicePath, Desktop::instance(),
+                QDBusConnection::ExportAllSlots |
+                QDBusConnection::ExportAllSignals |
+                QDBusConnection::ExportAllProperties)) {
+            qDebug() << "registerObject Failed" << conn.lastError();
+            exit(0x0003);
+        }
     }
 
-    if (!conn.registerObject(DesktopServicePath, Desktop::instance(),
-            QDBusConnection::ExportAllSlots |
-            QDBusConnection::ExportAllSignals |
-            QDBusConnection::ExportAllProperties)) {
-        qDebug() << "registerObject Failed" << conn.lastError();
-        exit(0x0003);
-    }
+    requestServiceName(conn);
 
     QThreadPool::globalInstance()->setMaxThreadCount(MAX_THREAD_COUNT);
-    Config::instance();
+    {
+        DDE_TRACE_SCOPE("Config::instance");
+        Config::instance();
+    }
 
-    Desktop::instance()->loadData();
-    Desktop::instance()->loadView();
-    Desktop::instance()->Show();
+    {
+        DDE_TRACE_SCOPE("Desktop::loadData");
+        Desktop::instance()->loadData();
+    }
+    {
+        DDE_TRACE_SCOPE("Desktop::loadView");
+        Desktop::instance()->loadView();
+    }
+    {
+        DDE_TRACE_SCOPE("Desktop::Show");
+        Desktop::instance()->Show();
+    }
 
-    DFMGlobal::installTranslator();
-    DFMGlobal::autoLoadDefaultPlugins();
-    DFMGlobal::autoLoadDefaultMenuExtensions();
-    DFMGlobal::initPluginManager();
-    DFMGlobal::initMimesAppsManager();
-    DFMGlobal::initDialogManager();
+    {
+        DDE_TRACE_SCOPE("DFMGlobal::installTranslator");
+        DFMGlobal::installTranslator();
+    }
 
-    // Notify dde-desktop start up
-    Dde::Session::RegisterDdeSession();
+    // the rest of DFMGlobal runs after the first paint, see DFMInitializer;
+    // start it anyway if the canvas is never painted
+    DFMInitializer::instance()->startAfter(3000);
 
+    // dde-desktop registers with the session once the canvas is mapped
+    // and the service name is ours, see Desktop::registerSession
+    Trace::instant("enter event loop");
     return app.exec();
 }
@@ -0,0 +1,554 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#include "desktopwatcher.h"
+
+#include <QFile>
+#include <QThread>
+#include <QTimer>
+#include <QSet>
+#include <QHash>
+#include <QMultiHash>
+#include <QVector>
+#include <QPair>
+#include <QDebug>
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../util/trace/trace.h"
+
+namespace
+{
+// creates and deletes only keep the link watches in step
+const quint32 WatchMask = IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO
+                          | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// on the target of a symlinked .desktop entry
+const quint32 LinkWatchMask = IN_CLOSE_WRITE | IN_ATTRIB;
+
+// room for a few hundred events per read
+const int EventBufferSize = 64 * 1024;
+
+// one frame at 60 Hz
+const int DrainInterval = 16;
+
+// events a frame takes from the queue, the rest wait for the next frame
+const int DrainBudget = 1024;
+
+// events the reader may queue ahead of the GUI thread before it drops
+// them; a rescan is cheaper than catching up on a flood
+const int MaxPendingEvents = 16 * 1024;
+}
+
+class DesktopWatcherReader : public QThread
+{
+public:
+    explicit DesktopWatcherReader(DesktopWatcher *watcher)
+        : m_watcher(watcher), m_wd(watcher->m_wd)
+    {
+        setObjectName("desktop watcher");
+        m_prefix = QFile::encodeName(watcher->m_prefix);
+    }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        // the directory watch is already in place, a link created from
+        // here on also shows up as IN_CREATE
+        scanLinks();
+
+        QByteArray buffer(EventBufferSize, Qt::Uninitialized);
+        struct pollfd fds[2];
+        fds[0].fd = m_watcher->m_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = m_watcher->m_stopFd;
+        fds[1].events = POLLIN;
+
+        for (;;) {
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+            if (::poll(fds, 2, -1) < 0) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                qWarning() << "poll inotify fd failed" << strerror(errno);
+                return;
+            }
+            if (fds[1].revents) {
+                return;
+            }
+            if (fds[0].revents) {
+                readEvents(buffer);
+            }
+        }
+    }
+
+private:
+    void readEvents(QByteArray &buffer)
+    {
+        for (;;) {
+            auto size = ::read(m_watcher->m_fd, buffer.data(), buffer.size());
+            if (size < 0) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                if (EAGAIN != errno) {
+                    qWarning() << "read inotify events failed" << strerror(errno);
+                }
+                break;
+            }
+            if (0 == size) {
+                break;
+            }
+            decode(buffer.constData(), size);
+            submit();
+        }
+
+        // the pair of a rename is queued together, a lone half left the desktop
+        flushMove();
+        submit();
+    }
+
+    void decode(const char *data, ssize_t size)
+    {
+        for (ssize_t offset = 0; offset < size;) {
+            auto event = reinterpret_cast<const inotify_event *>(data + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                qWarning() << "inotify queue overflow on" << m_watcher->path();
+                flushMove();
+                scanLinks();
+                add(WatchEvent::Overflow);
+                continue;
+            }
+
+            if (event->wd != m_wd) {
+                decodeLink(event);
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                add(WatchEvent::DirectoryGone);
+                continue;
+            }
+
+            if (0 == event->len) {
+                continue;
+            }
+            QByteArray name(event->name);
+
+            if (event->mask & (IN_CREATE | IN_DELETE)) {
+                unwatchLink(name);
+                if (event->mask & IN_CREATE) {
+                    watchLink(name);
+                }
+                continue;
+            }
+
+            if (event->mask & IN_MOVED_FROM) {
+                unwatchLink(name);
+                flushMove();
+                m_moveCookie = event->cookie;
+                m_moveFrom = name;
+                continue;
+            }
+
+            if (event->mask & IN_MOVED_TO) {
+                unwatchLink(name);
+                watchLink(name);
+
+                if (m_moveCookie && m_moveCookie == event->cookie) {
+                    add(WatchEvent::Moved, m_moveFrom, name);
+                    m_moveCookie = 0;
+                    m_moveFrom.clear();
+                } else {
+                    flushMove();
+                    add(WatchEvent::Moved, QByteArray(), name);
+                }
+                continue;
+            }
+
+            if (event->mask & IN_CLOSE_WRITE) {
+                add(WatchEvent::Closed, name);
+            }
+            if (event->mask & IN_ATTRIB) {
+                add(WatchEvent::AttributeChanged, name);
+            }
+        }
+    }
+
+    // an event on a link target, reported under the link's name
+    void decodeLink(const inotify_event *event)
+    {
+        auto names = m_linkNames.values(event->wd);
+
+        // the target was deleted or replaced, the link may resolve to a
+        // new file now; our own inotify_rm_watch left no names behind
+        if (event->mask & IN_IGNORED) {
+            m_linkNames.remove(event->wd);
+            for (auto &name : names) {
+                m_linkWatches.remove(name);
+                watchLink(name);
+                add(WatchEvent::AttributeChanged, name);
+            }
+            return;
+        }
+
+        for (auto &name : names) {
+            if (event->mask & IN_CLOSE_WRITE) {
+                add(WatchEvent::Closed, name);
+            }
+            if (event->mask & IN_ATTRIB) {
+                add(WatchEvent::AttributeChanged, name);
+            }
+        }
+    }
+
+    // inotify_add_watch follows the link, so the watch is on the target
+    void watchLink(const QByteArray &name)
+    {
+        if (!name.endsWith(".desktop") || m_linkWatches.contains(name)) {
+            return;
+        }
+
+        auto path = m_prefix + name;
+        struct stat st;
+        if (::lstat(path.constData(), &st) < 0 || !S_ISLNK(st.st_mode)) {
+            return;
+        }
+
+        auto wd = ::inotify_add_watch(m_watcher->m_fd, path.constData(), LinkWatchMask);
+        if (wd < 0) {
+            // dangling, nothing to watch until the link is replaced
+            return;
+        }
+        if (wd == m_wd) {
+            return;
+        }
+        m_linkWatches.insert(name, wd);
+        m_linkNames.insert(wd, name);
+    }
+
+    void unwatchLink(const QByteArray &name)
+    {
+        auto it = m_linkWatches.find(name);
+        if (it == m_linkWatches.end()) {
+            return;
+        }
+
+        auto wd = it.value();
+        m_linkWatches.erase(it);
+        m_linkNames.remove(wd, name);
+        // several links may share one target
+        if (!m_linkNames.contains(wd)) {
+            ::inotify_rm_watch(m_watcher->m_fd, wd);
+        }
+    }
+
+    // watch every symlinked .desktop entry from scratch
+    void scanLinks()
+    {
+        for (auto wd : m_linkNames.uniqueKeys()) {
+            ::inotify_rm_watch(m_watcher->m_fd, wd);
+        }
+        m_linkNames.clear();
+        m_linkWatches.clear();
+
+        auto dir = ::opendir(m_prefix.constData());
+        if (!dir) {
+            qWarning() << "scan desktop links failed" << m_watcher->path() << strerror(errno);
+            return;
+        }
+        while (auto entry = ::readdir(dir)) {
+            if (DT_LNK != entry->d_type && DT_UNKNOWN != entry->d_type) {
+                continue;
+            }
+            watchLink(QByteArray(entry->d_name));
+        }
+        ::closedir(dir);
+    }
+
+    void flushMove()
+    {
+        if (!m_moveCookie) {
+            return;
+        }
+
+        add(WatchEvent::Moved, m_moveFrom);
+        m_moveCookie = 0;
+        m_moveFrom.clear();
+    }
+
+    // repeated closes and attribute changes of a name within one read
+    // carry nothing new
+    void add(quint8 type, const QByteArray &name = QByteArray(),
+             const QByteArray &target = QByteArray())
+    {
+        if (WatchEvent::Closed == type || WatchEvent::AttributeChanged == type) {
+            auto &seen = WatchEvent::Closed == type ? m_seenClosed : m_seenAttribute;
+            if (seen.contains(name)) {
+                return;
+            }
+            seen.insert(name);
+        }
+        m_batch.append(type, name, target);
+    }
+
+    // one queue node for everything one read decoded
+    void submit()
+    {
+        m_seenClosed.clear();
+        m_seenAttribute.clear();
+        if (m_batch.isEmpty()) {
+            return;
+        }
+        m_watcher->post(std::move(m_batch));
+        m_batch = WatchBatch();
+    }
+
+    DesktopWatcher  *m_watcher;
+    // the directory watch, copied so the GUI thread may reset its own
+    int             m_wd;
+    QByteArray      m_prefix;
+
+    // symlinked .desktop entries by name, and their names by target watch
+    QHash<QByteArray, int>      m_linkWatches;
+    QMultiHash<int, QByteArray> m_linkNames;
+
+    // IN_MOVED_FROM waiting for its IN_MOVED_TO
+    quint32         m_moveCookie    = 0;
+    QByteArray      m_moveFrom;
+
+    // events of the current read, not queued yet
+    WatchBatch          m_batch;
+    QSet<QByteArray>    m_seenClosed;
+    QSet<QByteArray>    m_seenAttribute;
+};
+
+DesktopWatcher::DesktopWatcher(const QString &path, QObject *parent)
+    : QObject(parent), m_path(path), m_pending(0), m_overflowed(false), m_drainScheduled(false)
+{
+    m_prefix = path.endsWith('/') ? path : path + "/";
+
+    m_drainTimer = new QTimer(this);
+    m_drainTimer->setSingleShot(true);
+    m_drainTimer->setInterval(DrainInterval);
+    connect(m_drainTimer, &QTimer::timeout, this, &DesktopWatcher::drain);
+
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        qWarning() << "inotify_init1 failed" << strerror(errno);
+        return;
+    }
+
+    m_wd = ::inotify_add_watch(m_fd, QFile::encodeName(path).constData(), WatchMask);
+    if (m_wd < 0) {
+        qWarning() << "watch desktop directory failed" << path << strerror(errno);
+        return;
+    }
+
+    m_stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_stopFd < 0) {
+        qWarning() << "eventfd failed" << strerror(errno);
+        return;
+    }
+
+    m_reader = new DesktopWatcherReader(this);
+    m_reader->start();
+}
+
+DesktopWatcher::~DesktopWatcher()
+{
+    if (m_reader) {
+        quint64 stop = 1;
+        if (::write(m_stopFd, &stop, sizeof(stop)) < 0) {
+            qWarning() << "stop desktop watcher failed" << strerror(errno);
+        }
+        m_reader->wait();
+        delete m_reader;
+    }
+
+    if (m_stopFd >= 0) {
+        ::close(m_stopFd);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+const QString &DesktopWatcher::path() const
+{
+    return m_path;
+}
+
+bool DesktopWatcher::isWatching() const
+{
+    return m_wd >= 0;
+}
+
+quint64 DesktopWatcher::eventsDrained() const
+{
+    return m_eventsDrained;
+}
+
+quint64 DesktopWatcher::signalsEmitted() const
+{
+    return m_signalsEmitted;
+}
+
+void DesktopWatcher::post(WatchBatch &&batch)
+{
+    if (m_pending.load(std::memory_order_acquire) + batch.size() > MaxPendingEvents) {
+        // one overflow is enough until it is drained, a gone directory
+        // still has to get through
+        WatchBatch kept;
+        if (!m_overflowed.exchange(true, std::memory_order_acq_rel)) {
+            qWarning() << "desktop watcher fell behind, dropping events on" << m_path;
+            kept.append(WatchEvent::Overflow);
+        }
+        for (auto &event : batch.events) {
+            if (WatchEvent::DirectoryGone == event.type) {
+                kept.append(WatchEvent::DirectoryGone);
+                break;
+            }
+        }
+        if (kept.isEmpty()) {
+            return;
+        }
+        batch = std::move(kept);
+    }
+
+    m_pending.fetch_add(batch.size(), std::memory_order_acq_rel);
+    m_queue.push(std::move(batch));
+
+    // only the first batch after a drain wakes the GUI thread
+    if (!m_drainScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, "scheduleDrain", Qt::QueuedConnection);
+    }
+}
+
+void DesktopWatcher::scheduleDrain()
+{
+    if (!m_drainTimer->isActive()) {
+        m_drainTimer->start();
+    }
+}
+
+bool DesktopWatcher::nextBatch()
+{
+    if (!m_queue.pop(m_draining)) {
+        m_draining = WatchBatch();
+        m_drainPos = 0;
+        return false;
+    }
+    m_drainPos = 0;
+    m_pending.fetch_sub(m_draining.size(), std::memory_order_acq_rel);
+    return true;
+}
+
+void DesktopWatcher::drain()
+{
+    // batches pushed from here on schedule the next drain
+    m_drainScheduled.store(false, std::memory_order_release);
+
+    DDE_TRACE_SCOPE("DesktopWatcher::drain");
+
+    QVector<QPair<QByteArray, QByteArray> > moves;
+    QVector<QByteArray> closed;
+    QVector<QByteArray> attributeChanged;
+    QSet<QByteArray> seenClosed;
+    QSet<QByteArray> seenAttribute;
+    auto gone = false;
+    auto overflow = false;
+
+    int count = 0;
+    while (count < DrainBudget) {
+        if (m_drainPos >= m_draining.size() && !nextBatch()) {
+            break;
+        }
+
+        auto &event = m_draining.events.at(m_drainPos++);
+        ++count;
+        switch (event.type) {
+        case WatchEvent::Closed: {
+            auto name = m_draining.name(event.name);
+            if (!seenClosed.contains(name)) {
+                seenClosed.insert(name);
+                closed << name;
+            }
+            break;
+        }
+        case WatchEvent::AttributeChanged: {
+            auto name = m_draining.name(event.name);
+            if (!seenAttribute.contains(name)) {
+                seenAttribute.insert(name);
+                attributeChanged << name;
+            }
+            break;
+        }
+        case WatchEvent::Moved:
+            moves << qMakePair(m_draining.name(event.name), m_draining.name(event.target));
+            break;
+        case WatchEvent::DirectoryGone:
+            gone = true;
+            break;
+        case WatchEvent::Overflow:
+            overflow = true;
+            m_overflowed.store(false, std::memory_order_release);
+            break;
+        }
+    }
+
+    // the budget ran out, the rest goes in the next frame
+    if (m_drainPos < m_draining.size() || nextBatch()) {
+        m_drainTimer->start();
+    }
+
+    if (0 == count) {
+        return;
+    }
+    m_eventsDrained += count;
+
+    // renames first, a close in the same frame refers to the new name
+    for (auto &move : moves) {
+        emit fileMoved(move.first.isEmpty() ? QString() : localFile(move.first),
+                       move.second.isEmpty() ? QString() : localFile(move.second));
+    }
+    for (auto &name : closed) {
+        emit fileClosed(localFile(name));
+    }
+    for (auto &name : attributeChanged) {
+        emit fileAttributeChanged(localFile(name));
+    }
+    m_signalsEmitted += moves.size() + closed.size() + attributeChanged.size();
+
+    if (overflow) {
+        ++m_signalsEmitted;
+        emit overflowed();
+    }
+
+    if (gone && m_wd >= 0) {
+        m_wd = -1;
+        ++m_signalsEmitted;
+        emit directoryGone();
+    }
+}
+
+QString DesktopWatcher::localFile(const QByteArray &name) const
+{
+    return m_prefix + QFile::decodeName(name);
+}
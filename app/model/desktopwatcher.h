@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+#include <atomic>
+
+#include "../global/mpscqueue.h"
+
+class QTimer;
+class DesktopWatcherReader;
+
+// Decoded inotify event, names are offsets into the batch that holds it.
+struct WatchEvent {
+    enum Type : quint8 {
+        Closed,
+        AttributeChanged,
+        Moved,          // name moved to target, either may be empty
+        DirectoryGone,
+        Overflow,       // events were dropped, state must be rescanned
+    };
+
+    quint8      type    = Closed;
+    int         name    = -1;
+    int         target  = -1;
+};
+
+// Everything decoded from one read of the inotify fd. Names relative to
+// the watched directory are packed into one buffer, so a batch costs a
+// queue node and two allocations however many events it holds.
+struct WatchBatch {
+    QVector<WatchEvent> events;
+    QByteArray          names;
+
+    int size() const
+    {
+        return events.size();
+    }
+
+    bool isEmpty() const
+    {
+        return events.isEmpty();
+    }
+
+    void append(quint8 type, const QByteArray &name = QByteArray(),
+                const QByteArray &target = QByteArray())
+    {
+        WatchEvent event;
+        event.type = type;
+        event.name = store(name);
+        event.target = store(target);
+        events.append(event);
+    }
+
+    QByteArray name(int offset) const
+    {
+        return offset < 0 ? QByteArray() : QByteArray(names.constData() + offset);
+    }
+
+private:
+    int store(const QByteArray &name)
+    {
+        if (name.isEmpty()) {
+            return -1;
+        }
+        auto offset = names.size();
+        names.append(name).append('\0');
+        return offset;
+    }
+};
+
+// One inotify watch on the desktop directory.
+// Events of every entry in the directory arrive through the same watch
+// and are demultiplexed by name, so the watch count stays at one no
+// matter how many files the desktop holds. The only extra watches are on
+// the targets of symlinked .desktop entries, a directory watch does not
+// see writes behind a link. A reader thread blocks on the
+// inotify fd and decodes each read into one batch on a lock-free queue;
+// the GUI thread drains it at most once per frame and drops repeated
+// events of the same file. Both ends are bounded: a frame takes a fixed
+// number of events and leaves the rest to the next one, and a reader
+// that gets too far ahead drops its events and asks for a rescan.
+class DesktopWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DesktopWatcher(const QString &path, QObject *parent = 0);
+    ~DesktopWatcher();
+
+    const QString &path() const;
+    bool isWatching() const;
+
+    // events taken from the queue and signals emitted for them, since start
+    quint64 eventsDrained() const;
+    quint64 signalsEmitted() const;
+
+signals:
+    // a writer closed the file
+    void fileClosed(const QString &localFile);
+    void fileAttributeChanged(const QString &localFile);
+    // from or to is empty when the entry moved out of or into the desktop
+    void fileMoved(const QString &from, const QString &to);
+    void directoryGone();
+    // events were lost, every item may be stale
+    void overflowed();
+
+private slots:
+    void scheduleDrain();
+
+private:
+    friend class DesktopWatcherReader;
+
+    // reader thread side
+    void post(WatchBatch &&batch);
+
+    // GUI thread, false when the queue is empty
+    bool nextBatch();
+    void drain();
+    QString localFile(const QByteArray &name) const;
+
+    QString                 m_path;
+    QString                 m_prefix;
+    int                     m_fd            = -1;
+    int                     m_wd            = -1;
+    int                     m_stopFd        = -1;
+    DesktopWatcherReader    *m_reader       = nullptr;
+
+    MpscQueue<WatchBatch>   m_queue;
+    // events queued and not taken yet, and whether an overflow is queued
+    std::atomic<int>        m_pending;
+    std::atomic<bool>       m_overflowed;
+    std::atomic<bool>       m_drainScheduled;
+    QTimer                  *m_drainTimer   = nullptr;
+
+    // GUI thread, the batch a budget ran out in
+    WatchBatch              m_draining;
+    int                     m_drainPos      = 0;
+
+    quint64                 m_eventsDrained     = 0;
+    quint64                 m_signalsEmitted    = 0;
+};
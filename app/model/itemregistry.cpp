@@ -0,0 +1,386 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#include "itemregistry.h"
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <durl.h>
+
+namespace
+{
+const ItemHandle TombstoneHandle = 0xffffffff;
+const int MinBucketCount = 64;
+const int MinCompactGarbage = 4096;
+}
+
+const ItemHandle ItemRegistry::InvalidHandle;
+
+struct ItemEntry {
+    quint32 offset  = 0;
+    quint32 length  = 0;
+    uint    hash    = 0;
+    quint32 pins    = 0;
+    FileId  fileId;
+    bool    used    = false;
+    bool    owned   = false;    // false once released while still pinned
+};
+
+class ItemRegistryPrivate
+{
+public:
+    ItemRegistryPrivate()
+    {
+        // handle 0 is reserved for ItemRegistry::InvalidHandle
+        entries.resize(1);
+        buckets.fill(ItemRegistry::InvalidHandle, MinBucketCount);
+    }
+
+    // names inside the desktop root are stored relative to it, anything
+    // else keeps its absolute path, which always starts with a '/'
+    QByteArray encodeName(const QString &localFile) const
+    {
+        auto name = QFile::encodeName(localFile);
+        if (!rootPrefix.isEmpty() && name.startsWith(rootPrefix)) {
+            return name.mid(rootPrefix.length());
+        }
+        return name;
+    }
+
+    QString decodeName(const ItemEntry &entry) const
+    {
+        auto name = QByteArray::fromRawData(arena.constData() + entry.offset, entry.length);
+        if (name.startsWith('/')) {
+            return QFile::decodeName(name);
+        }
+        return QFile::decodeName(rootPrefix + name);
+    }
+
+    static inline uint hashName(const QByteArray &name)
+    {
+        return qHash(name);
+    }
+
+    inline bool sameName(const ItemEntry &entry, const QByteArray &name, uint hash) const
+    {
+        return entry.hash == hash
+               && entry.length == static_cast<quint32>(name.length())
+               && 0 == memcmp(arena.constData() + entry.offset, name.constData(), entry.length);
+    }
+
+    // return the bucket holding name, or -1
+    int findBucket(const QByteArray &name, uint hash) const
+    {
+        auto mask = buckets.size() - 1;
+        for (int i = hash & mask; ; i = (i + 1) & mask) {
+            auto handle = buckets[i];
+            if (ItemRegistry::InvalidHandle == handle) {
+                return -1;
+            }
+            if (TombstoneHandle != handle && sameName(entries[handle], name, hash)) {
+                return i;
+            }
+        }
+    }
+
+    void insertBucket(ItemHandle handle)
+    {
+        if ((usedBuckets + tombstones + 1) * 4 > buckets.size() * 3) {
+            auto bucketCount = buckets.size();
+            if ((usedBuckets + 1) * 2 > bucketCount) {
+                bucketCount *= 2;
+            }
+            rehash(bucketCount);
+        }
+
+        auto mask = buckets.size() - 1;
+        for (int i = entries[handle].hash & mask; ; i = (i + 1) & mask) {
+            auto current = buckets[i];
+            if (ItemRegistry::InvalidHandle == current || TombstoneHandle == current) {
+                if (TombstoneHandle == current) {
+                    --tombstones;
+                }
+                buckets[i] = handle;
+                ++usedBuckets;
+                return;
+            }
+        }
+    }
+
+    void removeBucket(ItemHandle handle)
+    {
+        auto mask = buckets.size() - 1;
+        for (int i = entries[handle].hash & mask; ; i = (i + 1) & mask) {
+            auto current = buckets[i];
+            if (ItemRegistry::InvalidHandle == current) {
+                return;
+            }
+            if (current == handle) {
+                buckets[i] = TombstoneHandle;
+                --usedBuckets;
+                ++tombstones;
+                return;
+            }
+        }
+    }
+
+    void rehash(int bucketCount)
+    {
+        buckets.fill(ItemRegistry::InvalidHandle, bucketCount);
+        usedBuckets = 0;
+        tombstones = 0;
+        auto mask = bucketCount - 1;
+        for (int handle = 1; handle < entries.size(); ++handle) {
+            if (!entries[handle].used) {
+                continue;
+            }
+            auto i = entries[handle].hash & mask;
+            while (ItemRegistry::InvalidHandle != buckets[i]) {
+                i = (i + 1) & mask;
+            }
+            buckets[i] = handle;
+            ++usedBuckets;
+        }
+    }
+
+    inline bool isValid(ItemHandle handle) const
+    {
+        return handle != ItemRegistry::InvalidHandle
+               && handle < static_cast<ItemHandle>(entries.size())
+               && entries[handle].used;
+    }
+
+    void free(ItemHandle handle)
+    {
+        removeBucket(handle);
+
+        auto &entry = entries[handle];
+        entry.used = false;
+        entry.owned = false;
+        garbage += entry.length;
+        freeHandles.push_back(handle);
+        --itemCount;
+
+        if (garbage > MinCompactGarbage && garbage * 2 > arena.size()) {
+            compact();
+        }
+    }
+
+    // drop the names of released items, handles keep their value
+    void compact()
+    {
+        QByteArray newArena;
+        newArena.reserve(arena.size() - garbage);
+        for (int handle = 1; handle < entries.size(); ++handle) {
+            auto &entry = entries[handle];
+            if (!entry.used) {
+                continue;
+            }
+            auto offset = newArena.size();
+            newArena.append(arena.constData() + entry.offset, entry.length);
+            entry.offset = offset;
+        }
+        arena = newArena;
+        garbage = 0;
+    }
+
+    mutable QMutex      mutex;
+
+    QString             rootPath;
+    QByteArray          rootPrefix;
+
+    QByteArray          arena;
+    int                 garbage         = 0;
+
+    QVector<ItemEntry>  entries;
+    QVector<ItemHandle> freeHandles;
+    int                 itemCount       = 0;
+
+    // open addressing table of handles, probed by name hash
+    QVector<ItemHandle> buckets;
+    int                 usedBuckets     = 0;
+    int                 tombstones      = 0;
+};
+
+ItemRegistry::ItemRegistry() : d(new ItemRegistryPrivate)
+{
+}
+
+ItemRegistry::~ItemRegistry()
+{
+}
+
+void ItemRegistry::setRootPath(const QString &rootPath)
+{
+    QMutexLocker lock(&d->mutex);
+    if (d->itemCount > 0) {
+        qWarning() << "change root of registry with" << d->itemCount << "items";
+    }
+
+    d->rootPath = rootPath;
+    d->rootPrefix = QFile::encodeName(rootPath);
+    if (!d->rootPrefix.endsWith('/')) {
+        d->rootPrefix.append('/');
+    }
+}
+
+QString ItemRegistry::rootPath() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->rootPath;
+}
+
+ItemHandle ItemRegistry::intern(const QString &localFile)
+{
+    if (localFile.isEmpty()) {
+        return InvalidHandle;
+    }
+
+    QMutexLocker lock(&d->mutex);
+    auto name = d->encodeName(localFile);
+    auto hash = d->hashName(name);
+    auto bucket = d->findBucket(name, hash);
+    if (bucket >= 0) {
+        auto handle = d->buckets[bucket];
+        d->entries[handle].owned = true;
+        return handle;
+    }
+
+    ItemHandle handle;
+    if (!d->freeHandles.isEmpty()) {
+        handle = d->freeHandles.takeLast();
+    } else {
+        handle = static_cast<ItemHandle>(d->entries.size());
+        d->entries.resize(d->entries.size() + 1);
+    }
+
+    auto &entry = d->entries[handle];
+    entry.offset = d->arena.size();
+    entry.length = name.length();
+    entry.hash = hash;
+    entry.pins = 0;
+    entry.used = true;
+    entry.owned = true;
+    d->arena.append(name);
+
+    struct stat st;
+    if (0 == ::lstat(QFile::encodeName(localFile).constData(), &st)) {
+        entry.fileId.device = st.st_dev;
+        entry.fileId.inode = st.st_ino;
+    } else {
+        entry.fileId = FileId();
+    }
+
+    d->insertBucket(handle);
+    ++d->itemCount;
+    return handle;
+}
+
+ItemHandle ItemRegistry::find(const QString &localFile) const
+{
+    if (localFile.isEmpty()) {
+        return InvalidHandle;
+    }
+
+    QMutexLocker lock(&d->mutex);
+    auto name = d->encodeName(localFile);
+    auto bucket = d->findBucket(name, d->hashName(name));
+    return bucket >= 0 ? d->buckets[bucket] : InvalidHandle;
+}
+
+void ItemRegistry::release(ItemHandle handle)
+{
+    QMutexLocker lock(&d->mutex);
+    if (!d->isValid(handle)) {
+        return;
+    }
+
+    auto &entry = d->entries[handle];
+    if (entry.pins > 0) {
+        entry.owned = false;
+        return;
+    }
+    d->free(handle);
+}
+
+void ItemRegistry::pin(ItemHandle handle)
+{
+    QMutexLocker lock(&d->mutex);
+    if (d->isValid(handle)) {
+        ++d->entries[handle].pins;
+    }
+}
+
+void ItemRegistry::unpin(ItemHandle handle)
+{
+    QMutexLocker lock(&d->mutex);
+    if (!d->isValid(handle)) {
+        return;
+    }
+
+    auto &entry = d->entries[handle];
+    Q_ASSERT(entry.pins > 0);
+    if (0 == --entry.pins && !entry.owned) {
+        d->free(handle);
+    }
+}
+
+bool ItemRegistry::isValid(ItemHandle handle) const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->isValid(handle);
+}
+
+QString ItemRegistry::localFile(ItemHandle handle) const
+{
+    QMutexLocker lock(&d->mutex);
+    if (!d->isValid(handle)) {
+        return QString();
+    }
+    return d->decodeName(d->entries[handle]);
+}
+
+FileId ItemRegistry::fileId(ItemHandle handle) const
+{
+    QMutexLocker lock(&d->mutex);
+    if (!d->isValid(handle)) {
+        return FileId();
+    }
+    return d->entries[handle].fileId;
+}
+
+DUrl ItemRegistry::url(ItemHandle handle) const
+{
+    auto file = localFile(handle);
+    if (file.isEmpty()) {
+        return DUrl();
+    }
+    return DUrl::fromLocalFile(file);
+}
+
+int ItemRegistry::count() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->itemCount;
+}
+
+int ItemRegistry::arenaSize() const
+{
+    QMutexLocker lock(&d->mutex);
+    return d->arena.size();
+}
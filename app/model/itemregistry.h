@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#pragma once
+
+#include <QtGlobal>
+#include <QHash>
+#include <QString>
+#include <QScopedPointer>
+
+#include "../global/singleton.h"
+
+class DUrl;
+
+typedef quint32 ItemHandle;
+
+// (st_dev, st_ino) of an item, stays the same across renames
+struct FileId {
+    quint64 device  = 0;
+    quint64 inode   = 0;
+
+    bool isValid() const
+    {
+        return inode != 0;
+    }
+
+    bool operator==(const FileId &other) const
+    {
+        return device == other.device && inode == other.inode;
+    }
+};
+
+inline uint qHash(const FileId &id, uint seed = 0)
+{
+    return ::qHash(id.device, seed) ^ ::qHash(id.inode, seed);
+}
+
+// Interns every desktop entry once and hands out a 32-bit handle for it.
+// Names are kept relative to the desktop root in a single byte arena, so
+// layout code can key cells by integers instead of absolute path strings.
+// The GUI thread owns the handles; other threads may resolve a handle
+// they pinned, and a released handle stays valid until its last unpin.
+class ItemRegistryPrivate;
+class ItemRegistry : public Singleton<ItemRegistry>
+{
+public:
+    static const ItemHandle InvalidHandle = 0;
+
+    void setRootPath(const QString &rootPath);
+    QString rootPath() const;
+
+    ItemHandle intern(const QString &localFile);
+    ItemHandle find(const QString &localFile) const;
+    void release(ItemHandle handle);
+    void pin(ItemHandle handle);
+    void unpin(ItemHandle handle);
+    bool isValid(ItemHandle handle) const;
+
+    QString localFile(ItemHandle handle) const;
+    // taken when the name is interned, so it is still known once the
+    // file has been renamed away
+    FileId fileId(ItemHandle handle) const;
+    DUrl url(ItemHandle handle) const;
+
+    int count() const;
+    int arenaSize() const;
+
+private:
+    Q_DISABLE_COPY(ItemRegistry)
+    friend Singleton<ItemRegistry>;
+
+    ItemRegistry();
+    ~ItemRegistry();
+
+    QScopedPointer<ItemRegistryPrivate> d;
+};
@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#include "dfminitializer.h"
+
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <dfmglobal.h>
+
+#include "../util/trace/trace.h"
+
+namespace
+{
+const DFMInitializer::Stage StageOrder[] = {
+    DFMInitializer::Plugins,
+    DFMInitializer::MenuExtensions,
+    DFMInitializer::PluginManager,
+    DFMInitializer::MimesApps,
+    DFMInitializer::Dialogs,
+};
+}
+
+DFMInitializer::DFMInitializer(QObject *parent) : QObject(parent)
+{
+}
+
+bool DFMInitializer::isReady(Stages stages) const
+{
+    return (m_done & stages) == stages;
+}
+
+void DFMInitializer::ensure(Stages stages)
+{
+    if (isReady(stages)) {
+        return;
+    }
+
+    qDebug() << "wait for DFMGlobal stages" << stages << "done" << m_done;
+    for (auto stage : StageOrder) {
+        if (stages.testFlag(stage)) {
+            runStage(stage);
+        }
+    }
+}
+
+void DFMInitializer::start()
+{
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+
+    QTimer::singleShot(0, this, &DFMInitializer::runNextStage);
+}
+
+void DFMInitializer::startAfter(int msec)
+{
+    QTimer::singleShot(msec, this, &DFMInitializer::start);
+}
+
+void DFMInitializer::runNextStage()
+{
+    for (auto stage : StageOrder) {
+        if (!m_done.testFlag(stage)) {
+            runStage(stage);
+            // yield to input and paint events between stages
+            QTimer::singleShot(0, this, &DFMInitializer::runNextStage);
+            return;
+        }
+    }
+}
+
+void DFMInitializer::runStage(Stage stage)
+{
+    if (m_done.testFlag(stage)) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    switch (stage) {
+    case Plugins: {
+        DDE_TRACE_SCOPE("DFMGlobal::autoLoadDefaultPlugins");
+        DFMGlobal::autoLoadDefaultPlugins();
+        break;
+    }
+    case MenuExtensions: {
+        DDE_TRACE_SCOPE("DFMGlobal::autoLoadDefaultMenuExtensions");
+        DFMGlobal::autoLoadDefaultMenuExtensions();
+        break;
+    }
+    case PluginManager: {
+        DDE_TRACE_SCOPE("DFMGlobal::initPluginManager");
+        DFMGlobal::initPluginManager();
+        break;
+    }
+    case MimesApps: {
+        DDE_TRACE_SCOPE("DFMGlobal::initMimesAppsManager");
+        DFMGlobal::initMimesAppsManager();
+        break;
+    }
+    case Dialogs: {
+        DDE_TRACE_SCOPE("DFMGlobal::initDialogManager");
+        DFMGlobal::initDialogManager();
+        break;
+    }
+    default:
+        qWarning() << "unknown DFMGlobal stage" << stage;
+        return;
+    }
+
+    m_done |= stage;
+    qDebug() << "DFMGlobal stage" << stage << "ready in" << timer.elapsed() << "ms";
+    emit stageReady(stage);
+
+    if (isReady(AllStages)) {
+        Trace::instant("DFMGlobal ready");
+        emit finished();
+    }
+}
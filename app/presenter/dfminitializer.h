@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#pragma once
+
+#include <QObject>
+#include "../global/singleton.h"
+
+// Staged DFMGlobal initialization.
+// Plugins, menu extensions, the mime apps and dialog managers are only
+// needed once the user opens a menu or launches a file, so they are kept
+// off the startup path: after the first paint they run one stage per
+// event loop turn, and any code that needs them calls ensure() first,
+// which finishes the missing stages synchronously.
+class DFMInitializer : public QObject, public Singleton<DFMInitializer>
+{
+    Q_OBJECT
+
+    friend class Singleton<DFMInitializer>;
+public:
+    enum Stage {
+        Plugins         = 0x01,
+        MenuExtensions  = 0x02,
+        PluginManager   = 0x04,
+        MimesApps       = 0x08,
+        Dialogs         = 0x10,
+
+        // barriers
+        MenuReady       = Plugins | MenuExtensions | PluginManager | MimesApps | Dialogs,
+        OpenFileReady   = MimesApps | Dialogs,
+        FileOperationReady = Dialogs,
+        AllStages       = MenuReady,
+    };
+    Q_DECLARE_FLAGS(Stages, Stage)
+
+    bool isReady(Stages stages) const;
+
+    // run whatever of stages has not run yet, in stage order
+    void ensure(Stages stages);
+
+public slots:
+    // start the idle schedule, the first call wins
+    void start();
+    void startAfter(int msec);
+
+signals:
+    void stageReady(Stage stage);
+    void finished();
+
+private:
+    explicit DFMInitializer(QObject *parent = 0);
+
+    void runNextStage();
+    void runStage(Stage stage);
+
+    Stages  m_done;
+    bool    m_started   = false;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(DFMInitializer::Stages)
@@ -11,26 +11,20 @@
 
 #include <QPoint>
 #include <QRect>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
 #include <QDebug>
 
 #include "../config/config.h"
+#include "../global/cellbitmap.h"
+#include "../util/trace/trace.h"
 
 #include "apppresenter.h"
 
-inline QString positionKey(QPoint pos)
+inline QString itemName(ItemHandle item)
 {
-    return QString("%1_%2").arg(pos.x()).arg(pos.y());
-}
-
-inline bool qQPointLessThanKey(const QPoint &key1, const QPoint &key2)
-{
-    return (key1.x() < key2.x()) ||
-           ((key1.x() ==  key2.x()) && (key1.y() < key2.y()));
-}
-
-template <> inline bool qMapLessThanKey(const QPoint &key1, const QPoint &key2)
-{
-    return qQPointLessThanKey(key1, key2);
+    return ItemRegistry::instance()->localFile(item);
 }
 
 class GridManagerPrivate
@@ -38,11 +32,9 @@ class GridManagerPrivate
 public:
     GridManagerPrivate()
     {
-        auto settings = Config::instance()->settings();
-        settings->beginGroup(Config::groupGeneral);
-        positionProfile = settings->value(Config::keyProfile).toString();
-        autoArrang = settings->value(Config::keyAutoAlign).toBool();
-        settings->endGroup();
+        auto config = Config::instance()->snapshot();
+        positionProfile = config->value(Config::groupGeneral, Config::keyProfile).toString();
+        autoArrang = config->value(Config::groupGeneral, Config::keyAutoAlign).toBool();
 
         coordWidth = 0;
         coordHeight = 0;
@@ -55,44 +47,76 @@ public:
 
     inline void clear()
     {
+        for (int i = m_cellStatus.firstSet(); i >= 0; i = m_cellStatus.nextSet(i + 1)) {
+            markDirty(i);
+        }
+
         m_itemGrids.clear();
-        m_gridItems.clear();
         m_overlapItems.clear();
 
-        for (int i = 0; i < m_cellStatus.length(); ++i) {
-            m_cellStatus[i] = false;
+        m_gridItems.fill(ItemRegistry::InvalidHandle);
+        m_cellStatus.clear();
+        releaseReserved();
+    }
+
+    // saved cells of items the model has not delivered yet
+    void reserve(QPoint pos, const QString &localFile)
+    {
+        if (!isValid(pos)) {
+            return;
         }
+        auto index = indexOfGridPos(pos);
+        if (m_cellStatus.test(index) || m_reservedCells.contains(index)) {
+            return;
+        }
+        m_reservedCells.insert(index, localFile);
+        m_reservedItems.insert(localFile, index);
     }
 
-    QStringList rangeItems()
+    void releaseReserved()
     {
-        QStringList sortItems;
+        m_reservedCells.clear();
+        m_reservedItems.clear();
+    }
 
-        auto inUsePos = m_gridItems.keys();
-        qSort(inUsePos.begin(), inUsePos.end(), qQPointLessThanKey);
+    // the saved cell of a late item, if it is still free
+    bool takeReservedPos(const QString &localFile, QPoint &pos)
+    {
+        auto it = m_reservedItems.find(localFile);
+        if (it == m_reservedItems.end()) {
+            return false;
+        }
+        auto index = it.value();
+        m_reservedItems.erase(it);
+        m_reservedCells.remove(index);
+        if (m_cellStatus.test(index)) {
+            return false;
+        }
+        pos = gridPosAt(index);
+        return true;
+    }
 
-        for (int index = 0; index < inUsePos.length(); ++index) {
-            auto gridPos = inUsePos.value(index);
-            auto item = m_gridItems.value(gridPos);
-            sortItems << item;
+    // cell index grows column by column, so walking the cell array
+    // visits items in the same order as a sorted position list
+    QList<ItemHandle> inUseItems() const
+    {
+        QList<ItemHandle> sortItems;
+        for (int i = m_cellStatus.firstSet(); i >= 0; i = m_cellStatus.nextSet(i + 1)) {
+            sortItems << m_gridItems[i];
         }
+        return sortItems;
+    }
 
+    QList<ItemHandle> rangeItems() const
+    {
+        QList<ItemHandle> sortItems = inUseItems();
         sortItems << m_overlapItems;
         return sortItems;
     }
 
     void arrange()
     {
-        QStringList sortItems;
-
-        auto inUsePos = m_gridItems.keys();
-        qSort(inUsePos.begin(), inUsePos.end(), qQPointLessThanKey);
-
-        for (int index = 0; index < inUsePos.length(); ++index) {
-            auto gridPos = inUsePos.value(index);
-            auto item = m_gridItems.value(gridPos);
-            sortItems << item;
-        }
+        QList<ItemHandle> sortItems = inUseItems();
 
         auto overlapItems = m_overlapItems;
 
@@ -114,37 +138,280 @@ public:
 
     void createProfile()
     {
-        m_cellStatus.resize(coordWidth * coordHeight);
+        m_cellStatus.resize(cellCount());
+        m_gridItems.resize(cellCount());
+
+        // a new profile starts from an empty persisted layout
+        m_persistedItems.fill(ItemRegistry::InvalidHandle, cellCount());
+        m_dirtyCells.resize(cellCount());
+        m_dirtyList.clear();
+
         clear();
     }
 
+    inline void markDirty(int index)
+    {
+        if (!m_dirtyCells.test(index)) {
+            m_dirtyCells.set(index);
+            m_dirtyList << index;
+        }
+    }
+
+    // the config now holds exactly the current layout
+    void rebasePersisted()
+    {
+        m_persistedItems = m_gridItems;
+        for (auto index : m_dirtyList) {
+            m_dirtyCells.reset(index);
+        }
+        m_dirtyList.clear();
+    }
+
+    // A rename arrives as a remove of the old name and an add of the new
+    // one. Removed items with a known inode keep their cell for a short
+    // window, hard links to the same inode each get their own entry.
+    bool park(ItemHandle item)
+    {
+        auto id = ItemRegistry::instance()->fileId(item);
+        if (!id.isValid() || !m_itemGrids.contains(item)) {
+            return false;
+        }
+        if (!m_parkedItems.contains(id, item)) {
+            m_parkedItems.insert(id, item);
+        }
+        return true;
+    }
+
+    // the name came back, e.g. a file replaced by renaming over it
+    void unpark(ItemHandle item)
+    {
+        for (auto it = m_parkedItems.begin(); it != m_parkedItems.end(); ++it) {
+            if (it.value() == item) {
+                m_parkedItems.erase(it);
+                return;
+            }
+        }
+    }
+
+    // An inode is reused as soon as a file is deleted, so a parked item
+    // is only taken over by the name the watcher saw it moved to.
+    bool takeOver(ItemHandle item)
+    {
+        auto registry = ItemRegistry::instance();
+        auto id = registry->fileId(item);
+        if (!id.isValid()) {
+            return false;
+        }
+
+        auto from = m_movedNames.value(registry->localFile(item));
+        if (from.isEmpty()) {
+            return false;
+        }
+
+        for (auto it = m_parkedItems.find(id); it != m_parkedItems.end() && it.key() == id; ++it) {
+            if (registry->localFile(it.value()) == from) {
+                auto oldItem = it.value();
+                m_parkedItems.erase(it);
+                adopt(oldItem, item);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // item goes to the cell of oldItem, leaving its own cell if it had one
+    void adopt(ItemHandle oldItem, ItemHandle item)
+    {
+        if (m_itemGrids.contains(item)) {
+            remove(m_itemGrids.value(item).position(), item);
+        }
+
+        auto coord = m_itemGrids.take(oldItem);
+        auto index = indexOfGridPos(coord.position());
+        m_gridItems[index] = item;
+        m_itemGrids.insert(item, coord);
+        markDirty(index);
+        releaseLater(oldItem);
+    }
+
+    // the window is over, whatever is still parked was really removed
+    bool dropParked()
+    {
+        auto dropped = false;
+        for (auto item : m_parkedItems) {
+            if (remove(m_itemGrids.value(item).position(), item)) {
+                releaseLater(item);
+                dropped = true;
+            }
+        }
+        m_parkedItems.clear();
+        m_movedNames.clear();
+        return dropped;
+    }
+
+    // handles are only given back after persist(), otherwise a handle
+    // reused for another file in the same cell would look unchanged
+    inline void releaseLater(ItemHandle item)
+    {
+        m_releasedItems << item;
+    }
+
+    // tell the Config thread which profile the following ops belong to
+    void queueProfile()
+    {
+        auto profile = Coordinate(coordWidth, coordHeight).key();
+        if (profile != m_queuedProfile) {
+            Config::instance()->pushLayoutOp(LayoutOp::SelectProfile, ItemRegistry::InvalidHandle, profile);
+            m_queuedProfile = profile;
+        }
+    }
+
+    // write the cells that differ from the last persisted layout
+    void persist()
+    {
+        auto config = Config::instance();
+        auto writeCount = 0;
+        for (auto index : m_dirtyList) {
+            m_dirtyCells.reset(index);
+
+            auto item = m_gridItems[index];
+            if (item == m_persistedItems[index]) {
+                continue;
+            }
+            m_persistedItems[index] = item;
+
+            if (0 == writeCount++) {
+                queueProfile();
+            }
+            auto cell = Coordinate(gridPosAt(index)).key();
+            if (item == ItemRegistry::InvalidHandle) {
+                config->pushLayoutOp(LayoutOp::RemoveCell, item, cell);
+            } else {
+                config->pushLayoutOp(LayoutOp::SetCell, item, cell);
+            }
+        }
+
+        auto dirtyCount = m_dirtyList.length();
+        m_dirtyList.clear();
+
+        // queued ops pinned what they still need
+        auto registry = ItemRegistry::instance();
+        for (auto item : m_releasedItems) {
+            registry->release(item);
+        }
+        m_releasedItems.clear();
+
+        if (0 == writeCount) {
+            return;
+        }
+
+        ++persistCount;
+        persistedCellCount += writeCount;
+        qDebug() << "persist" << writeCount << "cells of" << dirtyCount << "dirty,"
+                 << m_itemGrids.size() << "items in" << positionProfile;
+
+        config->commitLayoutOps();
+    }
+
+    bool addItems(const QStringList &itemIds)
+    {
+        auto registry = ItemRegistry::instance();
+
+        auto added = false;
+        for (auto &id : itemIds) {
+            auto item = registry->intern(id);
+            if (m_itemGrids.contains(item)) {
+                unpark(item);
+                continue;
+            }
+
+            QPoint pos;
+            if (takeReservedPos(id, pos)) {
+                added |= add(pos, item);
+                continue;
+            }
+            if (takeOver(item)) {
+                added = true;
+                continue;
+            }
+            added |= add(takeEmptyPos(), item);
+        }
+        return added;
+    }
+
+    bool removeItems(const QStringList &itemIds)
+    {
+        auto registry = ItemRegistry::instance();
+
+        // a cell may be freed and refilled from the overlap list several
+        // times in one batch, persist() only writes its final state
+        auto removed = false;
+        auto parked = false;
+        for (auto &id : itemIds) {
+            auto item = registry->find(id);
+            if (!m_itemGrids.contains(item)) {
+                continue;
+            }
+
+            if (park(item)) {
+                parked = true;
+                continue;
+            }
+
+            auto pos = m_itemGrids.value(item).position();
+            if (remove(pos, item)) {
+                releaseLater(item);
+                removed = true;
+            }
+        }
+
+        // parked items keep their cells, dropParked() arranges for them
+        if (parked) {
+            m_parkTimer->start();
+        }
+        return removed;
+    }
+
     void loadProfile(const QStringList &localFileLis)
     {
-        QMap<QString, int> existItems;
+        QMap<QString, ItemHandle> existItems;
 
-        for (auto &item : localFileLis) {
-            existItems.insert(item, 0);
+        auto registry = ItemRegistry::instance();
+        for (auto &localFile : localFileLis) {
+            existItems.insert(localFile, registry->intern(localFile));
         }
 
-        auto settings = Config::instance()->settings();
-        settings->beginGroup(positionProfile);
-        for (auto &key : settings->allKeys()) {
-            auto coords = key.split("_");
+        auto profile = Config::instance()->groupValues(positionProfile);
+        for (auto it = profile.constBegin(); it != profile.constEnd(); ++it) {
+            auto coords = it.key().split("_");
             auto x = coords.value(0).toInt();
             auto y = coords.value(1).toInt();
-            auto item = settings->value(key).toString();
-            if (existItems.contains(item)) {
-                add(QPoint(x, y), item);
-                existItems.remove(item);
+            auto localFile = it.value().toString();
+            if (!existItems.contains(localFile)) {
+                // the model lists in batches, keep the cell for a later one
+                if (!autoArrang) {
+                    reserve(QPoint(x, y), localFile);
+                }
+                continue;
+            }
+
+            // a cell out of this grid, from a hand edit or an older
+            // layout, falls through to an empty cell below; an item
+            // queued on the overlap cell is placed already
+            auto item = existItems.value(localFile);
+            if (add(QPoint(x, y), item) || m_overlapItems.contains(item)) {
+                existItems.remove(localFile);
             }
         }
-        settings->endGroup();
+
+        // items restored from the profile are already on disk
+        rebasePersisted();
 
         if (autoArrang) {
             arrange();
         }
 
-        for (auto &item : existItems.keys()) {
+        for (auto item : existItems.values()) {
             add(takeEmptyPos(), item);
         }
     }
@@ -172,64 +439,99 @@ public:
         return pos.x() * coordHeight + pos.y();
     }
 
+    inline ItemHandle itemAt(const QPoint &pos) const
+    {
+        if (!isValid(pos)) {
+            return ItemRegistry::InvalidHandle;
+        }
+        return m_gridItems[indexOfGridPos(pos)];
+    }
+
+    // the first free cell no late item has saved, or any free cell once
+    // all of them are saved
+    inline int freeIndex() const
+    {
+        auto index = m_cellStatus.firstClear();
+        if (m_reservedCells.isEmpty()) {
+            return index;
+        }
+        while (index >= 0 && m_reservedCells.contains(index)) {
+            index = m_cellStatus.nextClear(index + 1);
+        }
+        return index >= 0 ? index : m_cellStatus.firstClear();
+    }
+
     inline QPoint emptyPos() const
     {
-        for (int i = 0; i < m_cellStatus.size(); ++i) {
-            if (!m_cellStatus[i]) {
-                return gridPosAt(i);
-            }
+        auto index = freeIndex();
+        if (index >= 0) {
+            return gridPosAt(index);
         }
         return overlapPos();
     }
 
     inline QPoint takeEmptyPos()
     {
-        for (int i = 0; i < m_cellStatus.size(); ++i) {
-            if (!m_cellStatus[i]) {
-                m_cellStatus[i] = true;
-                return gridPosAt(i);
-            }
+        auto index = freeIndex();
+        if (index >= 0) {
+            m_cellStatus.set(index);
+            return gridPosAt(index);
         }
         return overlapPos();
     }
 
-    inline bool add(QPoint pos, const QString &itemId)
+    inline bool add(QPoint pos, ItemHandle item)
     {
-        if (m_gridItems.contains(pos)) {
+        if (!isValid(pos)) {
+            qWarning() << "add" << itemName(item) << "out of grid" << pos;
+            return false;
+        }
+
+        auto index = indexOfGridPos(pos);
+        if (m_gridItems[index] != ItemRegistry::InvalidHandle) {
             if (pos != overlapPos()) {
-                qCritical() << "add" << itemId  << "failed."
-                            << pos << "grid exist item" << m_gridItems.value(pos);
+                qCritical() << "add" << itemName(item)  << "failed."
+                            << pos << "grid exist item" << itemName(m_gridItems[index]);
                 return false;
             } else {
-                m_overlapItems << itemId;
+                m_overlapItems << item;
                 return false;
             }
         }
 
-        m_gridItems.insert(pos, itemId);
-        m_itemGrids.insert(itemId, pos);
-        m_cellStatus[indexOfGridPos(pos)] = true;
+        // whoever takes a saved cell, the reservation is spent
+        if (!m_reservedCells.isEmpty()) {
+            auto reserved = m_reservedCells.take(index);
+            if (!reserved.isEmpty()) {
+                m_reservedItems.remove(reserved);
+            }
+        }
+
+        m_gridItems[index] = item;
+        m_itemGrids.insert(item, Coordinate(pos));
+        m_cellStatus.set(index);
+        markDirty(index);
 
         return true;
     }
 
-    inline bool remove(QPoint pos, const QString &id)
+    inline bool remove(QPoint pos, ItemHandle item)
     {
-        if (!m_itemGrids.contains(id)) {
-            qDebug() << "can not remove" << pos << id;
+        if (!m_itemGrids.contains(item) || !isValid(pos)) {
+            qDebug() << "can not remove" << pos << itemName(item);
             return false;
         }
 
-        m_gridItems.remove(pos);
-        m_itemGrids.remove(id);
-
         auto usageIndex = indexOfGridPos(pos);
-        m_cellStatus[usageIndex] = false;
+        m_gridItems[usageIndex] = ItemRegistry::InvalidHandle;
+        m_itemGrids.remove(item);
+        m_cellStatus.reset(usageIndex);
+        markDirty(usageIndex);
 
         if (!m_overlapItems.isEmpty()
                 && (pos == overlapPos())) {
-            auto itemId = m_overlapItems.takeFirst();
-            add(pos, itemId);
+            auto overlapItem = m_overlapItems.takeFirst();
+            add(pos, overlapItem);
         }
         return true;
     }
@@ -260,14 +562,14 @@ public:
 
         auto allItems = m_itemGrids;
         QVector<int> preferNewIndex;
-        QVector<QString> itemIds;
+        QVector<ItemHandle> itemIds;
 
         // record old pos index
         for (int i = 0; i < m_cellStatus.length(); ++i) {
             if (m_cellStatus.value(i)) {
                 auto newIndex = i * newCellCount / oldCellCount;
                 preferNewIndex.push_back(newIndex);
-                itemIds.push_back(m_gridItems.value(gridPosAt(i)));
+                itemIds.push_back(m_gridItems.value(i));
             }
         }
 
@@ -336,7 +638,7 @@ public:
 //            qDebug() << "arrange";
             auto sortItems = rangeItems();
             resetGridSize(w, h);
-            for (int i = 0; i < newCellCount; ++i) {
+            for (int i = 0; i < newCellCount && !sortItems.isEmpty(); ++i) {
                 add(takeEmptyPos(), sortItems.takeFirst());
             }
             m_overlapItems = sortItems;
@@ -345,13 +647,13 @@ public:
             qDebug() << emptyCellCount << outCellCount << m_overlapItems.length();
             auto newEmptyCellCount = emptyCellCount - outCellCount + m_overlapItems.length();
             QVector<int> keepPosIndex;
-            QVector<QString> keepItems;
+            QVector<ItemHandle> keepItems;
 
             auto lastEmptyPosIndex = newCellCount;
             for (int i = 0; i < oldCellStatus.length(); ++i) {
                 if (oldCellStatus.value(i)) {
                     keepPosIndex.push_back(i);
-                    keepItems.push_back(m_gridItems.value(gridPosAt(i)));
+                    keepItems.push_back(m_gridItems.value(i));
                 } else {
                     if (newEmptyCellCount <= 0) {
                         lastEmptyPosIndex = i;
@@ -362,11 +664,11 @@ public:
             }
 
             QVector<int> nokeepPosIndex;
-            QVector<QString> nokeepItems;
+            QVector<ItemHandle> nokeepItems;
             for (int i = lastEmptyPosIndex; i < oldCellStatus.length(); ++i) {
                 if (oldCellStatus.value(i)) {
                     nokeepPosIndex.push_back(i);
-                    nokeepItems.push_back(m_gridItems.value(gridPosAt(i)));
+                    nokeepItems.push_back(m_gridItems.value(i));
                 }
             }
 
@@ -388,7 +690,7 @@ public:
             }
 
             // TODO
-            for (auto &item : overlapItems) {
+            for (auto item : overlapItems) {
                 add(takeEmptyPos(), item);
             }
 
@@ -408,17 +710,14 @@ public:
         } else {
             changeGridSize(w, h);
 
-            QStringList keyList;
-            QVariantList valueList;
-            for (auto pos : m_gridItems.keys()) {
-                keyList << positionKey(pos);
-                valueList << m_gridItems.value(pos);
+            auto config = Config::instance();
+            queueProfile();
+            config->pushLayoutOp(LayoutOp::RemoveProfile, ItemRegistry::InvalidHandle, 0);
+            for (int i = m_cellStatus.firstSet(); i >= 0; i = m_cellStatus.nextSet(i + 1)) {
+                config->pushLayoutOp(LayoutOp::SetCell, m_gridItems[i], Coordinate(gridPosAt(i)).key());
             }
-
-//            qDebug() << keyList;
-
-            emit Presenter::instance()->removeConfig(positionProfile, "");
-            emit Presenter::instance()->setConfigList(positionProfile, keyList, valueList);
+            config->commitLayoutOps();
+            rebasePersisted();
 
             return this->autoArrang;
         }
@@ -426,10 +725,33 @@ public:
     }
 
 public:
-    QStringList             m_overlapItems;
-    QMap<QPoint, QString>   m_gridItems;
-    QMap<QString, QPoint>   m_itemGrids;
-    QVector<bool>           m_cellStatus;
+    QList<ItemHandle>               m_overlapItems;
+    QVector<ItemHandle>             m_gridItems;    // indexed by indexOfGridPos()
+    QHash<ItemHandle, Coordinate>   m_itemGrids;
+    CellBitmap                      m_cellStatus;
+
+    // last layout sent to the config, and the cells changed since then
+    QVector<ItemHandle>             m_persistedItems;
+    CellBitmap                      m_dirtyCells;
+    QVector<int>                    m_dirtyList;
+    QVector<ItemHandle>             m_releasedItems;
+
+    // removed items waiting for a rename to take over their cell
+    QMultiHash<FileId, ItemHandle>  m_parkedItems;
+    // new name -> old name of the renames seen in the park window
+    QHash<QString, QString>         m_movedNames;
+    QTimer                          *m_parkTimer = nullptr;
+
+    // cell index <-> local file of saved cells kept free until the model
+    // has listed the whole desktop
+    QHash<int, QString>             m_reservedCells;
+    QHash<QString, int>             m_reservedItems;
+
+    quint64                 persistCount        = 0;
+    quint64                 persistedCellCount  = 0;
+
+    // grid size of the profile the Config thread writes to
+    Coordinate::CoordValue  m_queuedProfile     = ~Coordinate::CoordValue(0);
 
     QString                 positionProfile;
     int                     coordWidth;
@@ -441,6 +763,19 @@ public:
 
 GridManager::GridManager(): d(new GridManagerPrivate)
 {
+    d->m_parkTimer = new QTimer(this);
+    d->m_parkTimer->setSingleShot(true);
+    d->m_parkTimer->setInterval(1000);
+    connect(d->m_parkTimer, &QTimer::timeout, this, [ = ]() {
+        if (!d->dropParked()) {
+            return;
+        }
+        if (d->autoArrang) {
+            d->arrange();
+        }
+        d->persist();
+        emit layoutChanged();
+    });
 }
 
 GridManager::~GridManager()
@@ -455,52 +790,83 @@ bool GridManager::isInited() const
 
 void GridManager::initProfile(const QStringList &items)
 {
+    DDE_TRACE_SCOPE("GridManager::initProfile");
     d->loadProfile(items);
+    d->persist();
     d->hasInited = true;
 }
 
+void GridManager::settleProfile()
+{
+    if (!d->m_reservedCells.isEmpty()) {
+        qDebug() << "release" << d->m_reservedCells.size() << "saved cells of missing items";
+    }
+    d->releaseReserved();
+}
+
+QStringList GridManager::itemIds() const
+{
+    auto registry = ItemRegistry::instance();
+    QStringList ids;
+    for (auto it = d->m_itemGrids.constBegin(); it != d->m_itemGrids.constEnd(); ++it) {
+        ids << registry->localFile(it.key());
+    }
+    for (auto item : d->m_overlapItems) {
+        ids << registry->localFile(item);
+    }
+    return ids;
+}
+
 bool GridManager::add(const QString &id)
 {
-    if (d->m_itemGrids.contains(id)) {
+    auto item = ItemRegistry::instance()->intern(id);
+    if (d->m_itemGrids.contains(item)) {
 //        qDebug() << "item exist item" << d->itemGrids.value(id) << id;
+        d->unpark(item);
         return false;
     }
 
-    return add(d->takeEmptyPos(), id);
+    QPoint pos;
+    if (d->takeReservedPos(id, pos)) {
+        return add(pos, item);
+    }
+
+    if (d->takeOver(item)) {
+        d->persist();
+        return true;
+    }
+
+    return add(d->takeEmptyPos(), item);
 }
 
-bool GridManager::add(QPoint pos, const QString &id)
+bool GridManager::add(QPoint pos, ItemHandle item)
 {
-    auto ret = d->add(pos, id);
-    if (ret) {
-        emit Presenter::instance()->setConfig(d->positionProfile, positionKey(pos), id);
-    }
+    auto ret = d->add(pos, item);
+    d->persist();
     return ret;
 }
 
-bool GridManager::move(const QStringList &selecteds, const QString &current, int x, int y)
+bool GridManager::move(const QList<ItemHandle> &selecteds, ItemHandle current, int x, int y)
 {
-    auto currentPos = d->m_itemGrids.value(current);
+    auto currentPos = d->m_itemGrids.value(current).position();
     auto destPos = QPoint(x, y);
     auto offset = destPos - currentPos;
 
-    QList<QPoint> originPosList;
     QList<QPoint> destPosList;
-    // check dest is empty;
-    auto destPosMap = d->m_gridItems;
-    auto destUsedGrids = d->m_cellStatus;
-    for (auto &id : selecteds) {
-        auto oldPos = d->m_itemGrids.value(id);
-        originPosList << oldPos;
-        destPosMap.remove(oldPos);
-        destUsedGrids[d->indexOfGridPos(oldPos)] = false;
-        auto destPos = oldPos + offset;
-        destPosList << destPos;
+    for (auto item : selecteds) {
+        auto oldPos = d->m_itemGrids.value(item).position();
+        destPosList << oldPos + offset;
+    }
+
+    // release the selection first, its own cells are valid destinations
+    for (auto item : selecteds) {
+        d->remove(d->m_itemGrids.value(item).position(), item);
     }
 
+    // check dest is empty;
     bool confict = false;
     for (auto pos : destPosList) {
-        if (destPosMap.contains(pos) || !d->isValid(pos)) {
+        if (!d->isValid(pos) || d->m_cellStatus.test(d->indexOfGridPos(pos))) {
             confict = true;
             break;
         }
@@ -508,148 +874,223 @@ bool GridManager::move(const QStringList &selecteds, const QString &current, int
 
     // no need to resize
     if (confict) {
+        auto &cellStatus = d->m_cellStatus;
+        auto freeCount = cellStatus.freeCount();
+        Q_ASSERT(freeCount >= selecteds.length());
+
+        // count free grid before destPos, -1 if destPos is not free
         auto selectedHeadCount = selecteds.indexOf(current);
-        // find free grid before destPos
         auto destIndex = d->indexOfGridPos(destPos);
-
-        QList<int> emptyIndexList;
-
-        for (int  i = 0; i < d->cellCount(); ++i) {
-            if (false == destUsedGrids.value(i)) {
-                emptyIndexList << i;
-            }
+        auto destGridHeadCount = -1;
+        if (d->isValid(destPos) && !cellStatus.test(destIndex)) {
+            destGridHeadCount = cellStatus.rank(destIndex);
         }
-        auto destGridHeadCount = emptyIndexList.indexOf(destIndex);
-
-        Q_ASSERT(emptyIndexList.length() >= selecteds.length());
 
-        auto startIndex = emptyIndexList.indexOf(destIndex) - selectedHeadCount;
+        auto startIndex = destGridHeadCount - selectedHeadCount;
         if (destGridHeadCount < selectedHeadCount) {
             startIndex = 0;
         }
-        auto destTailCount = emptyIndexList.length() - destGridHeadCount;
+        auto destTailCount = freeCount - destGridHeadCount;
         auto selectedTailCount = selecteds.length() - selectedHeadCount;
         if (destTailCount <= selectedTailCount) {
-            startIndex = emptyIndexList.length() - selecteds.length();
+            startIndex = qMax(0, freeCount - selecteds.length());
         }
 
         destPosList.clear();
-
-        startIndex = emptyIndexList.value(startIndex);
-        for (int i = startIndex; i < d->cellCount(); ++i) {
-            if (false == destUsedGrids.value(i)) {
-                destPosList << d->gridPosAt(i);
-            }
+        for (int i = cellStatus.select(startIndex);
+                i >= 0 && destPosList.length() < selecteds.length();
+                i = cellStatus.nextClear(i + 1)) {
+            destPosList << d->gridPosAt(i);
         }
-
     }
 
     for (int i = 0; i < selecteds.length(); ++i) {
-        remove(selecteds.value(i));
-    }
-    for (int i = 0; i < selecteds.length(); ++i) {
-        add(destPosList.value(i), selecteds.value(i));
+        d->add(destPosList.value(i), selecteds.value(i));
     }
 
     if (d->autoArrang) {
-        reAlign();
+        d->arrange();
     }
+    d->persist();
 
     return true;
 }
 
 bool GridManager::remove(const QString &id)
 {
-    auto pos = d->m_itemGrids.value(id);
-    return remove(pos, id);
+    auto registry = ItemRegistry::instance();
+    auto item = registry->find(id);
+    if (!d->m_itemGrids.contains(item)) {
+        return false;
+    }
+
+    if (d->park(item)) {
+        d->m_parkTimer->start();
+        return true;
+    }
+
+    auto ret = d->remove(d->m_itemGrids.value(item).position(), item);
+    if (ret) {
+        d->releaseLater(item);
+    }
+    d->persist();
+    return ret;
+}
+
+void GridManager::noteMove(const QString &from, const QString &to)
+{
+    if (from.isEmpty() || to.isEmpty()) {
+        return;
+    }
+    d->m_movedNames.insert(to, from);
+    if (!d->m_parkTimer->isActive()) {
+        d->m_parkTimer->start();
+    }
+
+    // the new name may already have been placed before the move was seen
+    auto item = ItemRegistry::instance()->find(to);
+    if (d->m_itemGrids.contains(item) && d->takeOver(item)) {
+        d->persist();
+        emit layoutChanged();
+    }
 }
 
-bool GridManager::remove(int x, int y, const QString &id)
+bool GridManager::remove(QPoint pos, ItemHandle item)
 {
-    auto pos = QPoint(x, y);
-    return remove(pos, id);
+    auto ret = d->remove(pos, item);
+    d->persist();
+    return ret;
 }
 
-bool GridManager::remove(QPoint pos, const QString &id)
+bool GridManager::addBatch(const QStringList &itemIds)
 {
-    auto ret = d->remove(pos, id);
-    if (ret) {
-        auto newItemId = d->m_gridItems.value(pos);
-        if (newItemId.isEmpty()) {
-            emit Presenter::instance()->removeConfig(d->positionProfile, positionKey(pos));
-        } else {
-            emit Presenter::instance()->setConfig(d->positionProfile, positionKey(pos), newItemId);
-        }
+    auto added = d->addItems(itemIds);
+    d->persist();
+    return added;
+}
+
+bool GridManager::removeBatch(const QStringList &itemIds)
+{
+    auto removed = d->removeItems(itemIds);
+    d->persist();
+    return removed;
+}
+
+bool GridManager::applyBatch(const QStringList &removedIds, const QStringList &addedIds)
+{
+    // removals first, so a rename in the batch is parked before its new
+    // name takes the cell over
+    auto removed = d->removeItems(removedIds);
+    auto added = d->addItems(addedIds);
+
+    if (removed && d->autoArrang) {
+        d->arrange();
     }
-    return ret;
+    d->persist();
+    return removed || added;
 }
 
 bool GridManager::clear()
 {
+    auto registry = ItemRegistry::instance();
+    for (auto item : d->m_itemGrids.keys()) {
+        registry->release(item);
+    }
+    for (auto item : d->m_overlapItems) {
+        registry->release(item);
+    }
+    d->m_parkedItems.clear();
+    d->m_movedNames.clear();
+    d->m_parkTimer->stop();
+
     d->createProfile();
 
-    emit Presenter::instance()->removeConfig(d->positionProfile, "");
+    auto config = Config::instance();
+    d->queueProfile();
+    config->pushLayoutOp(LayoutOp::RemoveProfile, ItemRegistry::InvalidHandle, 0);
+    config->commitLayoutOps();
 
     return true;
 }
 
 QString GridManager::firstItemId()
 {
-    for (int i = 0; i < d->m_cellStatus.length(); ++i) {
-        if (d->m_cellStatus.value(i)) {
-            auto pos = d->gridPosAt(i);
-            return  itemId(pos);
-        }
-    }
-    return "";
+    return itemName(firstItem());
 }
 
 QString GridManager::lastItemId()
 {
-    auto len = d->m_cellStatus.length();
-    for (int i = 0; i < len; ++i) {
-        if (d->m_cellStatus.value(len - 1 - i)) {
-            auto pos = d->gridPosAt(len - 1 - i);
-            return  itemId(pos);
-        }
-    }
-    return "";
+    return itemName(lastItem());
 }
 
 bool GridManager::contains(const QString &id)
 {
-    return d->m_itemGrids.contains(id);
+    return d->m_itemGrids.contains(ItemRegistry::instance()->find(id));
 }
 
 QPoint GridManager::position(const QString &id)
 {
-    if (!d->m_itemGrids.contains(id)) {
-        return d->overlapPos();
-    }
-
-    return d->m_itemGrids.value(id);
+    return position(ItemRegistry::instance()->find(id));
 }
 
 QString GridManager::itemId(int x, int y)
 {
-    return d->m_gridItems.value(QPoint(x, y));
+    return itemName(item(x, y));
 }
 
 QString GridManager::itemId(QPoint pos)
 {
-    return d->m_gridItems.value(pos);
+    return itemName(d->itemAt(pos));
 }
 
 bool GridManager::isEmpty(int x, int y)
 {
-    return !d->m_cellStatus.value(d->indexOfGridPos(QPoint(x, y)));
+    auto pos = QPoint(x, y);
+    return !d->isValid(pos) || !d->m_cellStatus.test(d->indexOfGridPos(pos));
 }
 
-const QStringList &GridManager::overlapItems() const
+ItemHandle GridManager::firstItem() const
+{
+    auto index = d->m_cellStatus.firstSet();
+    if (index >= 0) {
+        return d->m_gridItems.value(index);
+    }
+    return ItemRegistry::InvalidHandle;
+}
+
+ItemHandle GridManager::lastItem() const
+{
+    auto index = d->m_cellStatus.lastSet();
+    if (index >= 0) {
+        return d->m_gridItems.value(index);
+    }
+    return ItemRegistry::InvalidHandle;
+}
+
+ItemHandle GridManager::item(int x, int y) const
+{
+    return d->itemAt(QPoint(x, y));
+}
+
+QPoint GridManager::position(ItemHandle item) const
+{
+    if (!d->m_itemGrids.contains(item)) {
+        return d->overlapPos();
+    }
+
+    return d->m_itemGrids.value(item).position();
+}
+
+const QList<ItemHandle> &GridManager::overlapItems() const
 {
     return d->m_overlapItems;
 }
 
+quint64 GridManager::persistedCellCount() const
+{
+    return d->persistedCellCount;
+}
+
 bool GridManager::autoAlign()
 {
     return d->autoArrang;
@@ -670,22 +1111,14 @@ void GridManager::toggleAlign()
 void GridManager:: reAlign()
 {
     d->arrange();
-
-    QStringList keyList;
-    QVariantList valueList;
-    for (auto pos : d->m_gridItems.keys()) {
-        keyList << positionKey(pos);
-        valueList << d->m_gridItems.value(pos);
-    }
-
-    emit Presenter::instance()->removeConfig(d->positionProfile, "");
-    emit Presenter::instance()->setConfigList(d->positionProfile, keyList, valueList);
+    d->persist();
 }
 
 void GridManager::updateGridSize(int w, int h)
 {
     if (d->updateGridProfile(w, h)) {
         d->arrange();
+        d->persist();
     }
 
     emit Presenter::instance()->setConfig(Config::groupGeneral,
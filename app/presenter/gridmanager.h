@@ -16,6 +16,7 @@
 
 #include "../global/coorinate.h"
 #include "../global/singleton.h"
+#include "../model/itemregistry.h"
 
 class GridManagerPrivate;
 class GridManager: public QObject, public Singleton<GridManager>
@@ -23,11 +24,26 @@ class GridManager: public QObject, public Singleton<GridManager>
     Q_OBJECT
 public:
     bool isInited() const;
+    // place the items at their saved cells; the saved cells of the other
+    // items in the profile stay free for them until settleProfile()
     void initProfile(const QStringList &items);
+    void settleProfile();
+    // local files of every placed item, overlapping ones included
+    QStringList itemIds() const;
 
     bool add(const QString &itemId);
-    bool move(const QStringList &selectedIds, const QString &itemId, int x, int y);
+    bool move(const QList<ItemHandle> &selecteds, ItemHandle current, int x, int y);
     bool remove(const QString &itemId);
+    // a rename seen by the directory watcher, lets the new name take
+    // over the cell of the old one
+    void noteMove(const QString &from, const QString &to);
+
+    // place or drop a whole model range, persisting it with one config write
+    bool addBatch(const QStringList &itemIds);
+    bool removeBatch(const QStringList &itemIds);
+    // one layout transaction: drop, place, re-arrange if auto aligned and
+    // a cell was freed, persist once; parked items are settled later
+    bool applyBatch(const QStringList &removedIds, const QStringList &addedIds);
 
     bool clear();
 
@@ -40,17 +56,29 @@ public:
     QString itemId(QPoint pos);
     bool isEmpty(int x, int y);
 
-    const QStringList& overlapItems() const;
+    // handle based lookups for the paint and hit test paths
+    ItemHandle firstItem() const;
+    ItemHandle lastItem() const;
+    ItemHandle item(int x, int y) const;
+    QPoint position(ItemHandle item) const;
+
+    const QList<ItemHandle> &overlapItems() const;
     bool autoAlign();
     void toggleAlign();
     void reAlign();
 
     void updateGridSize(int w, int h);
 
+    // cells written to the config since start, for write volume tracking
+    quint64 persistedCellCount() const;
+
+signals:
+    // items changed cells outside of a model signal
+    void layoutChanged();
+
 protected:
-    bool remove(int x, int y, const QString &itemId);
-    bool remove(QPoint pos, const QString &itemId);
-    bool add(QPoint pos, const QString &itemId);
+    bool remove(QPoint pos, ItemHandle item);
+    bool add(QPoint pos, ItemHandle item);
 
     friend Singleton<GridManager>;
 
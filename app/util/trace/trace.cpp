@@ -0,0 +1,220 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#include "trace.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+#include <QHash>
+#include <QDebug>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+const char *TraceEnv = "DDE_DESKTOP_TRACE";
+
+// keep a forgotten env var from growing the process without bound
+const int MaxEvents = 100000;
+
+struct Event {
+    const char  *name;
+    char        phase;
+    qint64      timestamp;
+    qint64      duration;   // the value of a counter
+    qint64      tid;
+};
+
+struct TraceState {
+    bool                    enabled = false;
+    QString                 path;
+    qint64                  mainTid = 0;
+    QElapsedTimer           clock;
+
+    QMutex                  mutex;
+    QVector<Event>          events;
+    QHash<qint64, QString>  threadNames;
+    quint64                 dropped = 0;
+};
+
+TraceState &state()
+{
+    static TraceState traceState;
+    return traceState;
+}
+
+qint64 currentTid()
+{
+    return static_cast<qint64>(::syscall(SYS_gettid));
+}
+
+QString currentThreadName(qint64 tid)
+{
+    if (tid == state().mainTid) {
+        return "main";
+    }
+    auto thread = QThread::currentThread();
+    if (!thread->objectName().isEmpty()) {
+        return thread->objectName();
+    }
+    return QString("thread %1").arg(tid);
+}
+
+void record(const char *name, char phase, qint64 timestamp, qint64 duration)
+{
+    auto &s = state();
+    auto tid = currentTid();
+
+    QMutexLocker locker(&s.mutex);
+    if (s.events.size() >= MaxEvents) {
+        ++s.dropped;
+        return;
+    }
+    if (!s.threadNames.contains(tid)) {
+        s.threadNames.insert(tid, currentThreadName(tid));
+    }
+    s.events.append(Event{name, phase, timestamp, duration, tid});
+}
+}
+
+void Trace::init()
+{
+    auto &s = state();
+    if (s.clock.isValid()) {
+        return;
+    }
+    s.clock.start();
+    s.mainTid = currentTid();
+
+    auto value = QString::fromLocal8Bit(qgetenv(TraceEnv));
+    if (value.isEmpty() || value == "0") {
+        return;
+    }
+
+    s.enabled = true;
+    s.path = (value == "1") ? QString("/tmp/dde-desktop-trace-%1.json").arg(::getpid()) : value;
+    s.events.reserve(4096);
+    qDebug() << "startup tracing enabled, write to" << s.path;
+}
+
+bool Trace::isEnabled()
+{
+    return state().enabled;
+}
+
+qint64 Trace::now()
+{
+    return state().clock.nsecsElapsed() / 1000;
+}
+
+void Trace::complete(const char *name, qint64 begin, qint64 duration)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    record(name, 'X', begin, duration);
+}
+
+void Trace::instant(const char *name)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    record(name, 'i', now(), 0);
+}
+
+void Trace::counter(const char *name, qint64 value)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    record(name, 'C', now(), value);
+}
+
+bool Trace::flush()
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    auto &s = state();
+    auto pid = static_cast<qint64>(::getpid());
+
+    QJsonArray traceEvents;
+    QMutexLocker locker(&s.mutex);
+    for (auto it = s.threadNames.constBegin(); it != s.threadNames.constEnd(); ++it) {
+        QJsonObject meta;
+        meta.insert("name", "thread_name");
+        meta.insert("ph", "M");
+        meta.insert("pid", pid);
+        meta.insert("tid", it.key());
+        meta.insert("args", QJsonObject{{"name", it.value()}});
+        traceEvents.append(meta);
+    }
+
+    for (auto &event : s.events) {
+        QJsonObject object;
+        object.insert("name", QString::fromLatin1(event.name));
+        object.insert("cat", "startup");
+        object.insert("ph", QString(QChar(event.phase)));
+        object.insert("ts", event.timestamp);
+        object.insert("pid", pid);
+        object.insert("tid", event.tid);
+        if (event.phase == 'X') {
+            object.insert("dur", event.duration);
+        } else if (event.phase == 'C') {
+            object.insert("args", QJsonObject{{"value", event.duration}});
+        } else {
+            object.insert("s", "t");
+        }
+        traceEvents.append(object);
+    }
+    auto count = s.events.size();
+    auto dropped = s.dropped;
+    locker.unlock();
+
+    QJsonObject root;
+    root.insert("traceEvents", traceEvents);
+    root.insert("displayTimeUnit", "ms");
+
+    QSaveFile file(s.path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "open trace file failed" << s.path << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "write trace file failed" << s.path << file.errorString();
+        return false;
+    }
+
+    qDebug() << "write" << count << "trace events to" << s.path << "dropped" << dropped;
+    return true;
+}
+
+Trace::Scope::Scope(const char *name, bool enabled)
+    : m_name((enabled && isEnabled()) ? name : nullptr),
+      m_begin(m_name ? now() : 0)
+{
+}
+
+Trace::Scope::~Scope()
+{
+    if (m_name) {
+        complete(m_name, m_begin, now() - m_begin);
+    }
+}
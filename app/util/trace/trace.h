@@ -0,0 +1,52 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+#pragma once
+
+#include <QtGlobal>
+
+// Startup timeline tracing.
+// Set DDE_DESKTOP_TRACE to a file path (or to 1 for
+// /tmp/dde-desktop-trace-<pid>.json) and the recorded spans and instant
+// events are written as Chrome trace JSON, ready for chrome://tracing.
+// When the variable is unset every call returns after one branch.
+namespace Trace
+{
+// start the clock and read the env, call first thing in main
+void init();
+bool isEnabled();
+
+// microseconds since init()
+qint64 now();
+
+void complete(const char *name, qint64 begin, qint64 duration);
+void instant(const char *name);
+// a sampled value, drawn as a counter track
+void counter(const char *name, qint64 value);
+
+// write every event recorded so far, may be called repeatedly
+bool flush();
+
+class Scope
+{
+public:
+    explicit Scope(const char *name, bool enabled = true);
+    ~Scope();
+
+private:
+    Q_DISABLE_COPY(Scope)
+
+    const char  *m_name;
+    qint64      m_begin;
+};
+}
+
+#define DDE_TRACE_CONCAT_(a, b) a##b
+#define DDE_TRACE_CONCAT(a, b) DDE_TRACE_CONCAT_(a, b)
+#define DDE_TRACE_SCOPE(name) Trace::Scope DDE_TRACE_CONCAT(traceScope, __LINE__)(name)
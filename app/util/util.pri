@@ -1,9 +1,11 @@
 HEADERS += \
     $$PWD/dde/ddesession.h \
     $$PWD/xcb/xcb.h \
+    $$PWD/trace/trace.h \
     $$PWD/util.h
 
 SOURCES += \
     $$PWD/dde/ddesession.cpp \
     $$PWD/xcb/xcb.cpp \
+    $$PWD/trace/trace.cpp \
     $$PWD/util.cpp
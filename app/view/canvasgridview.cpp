@@ -50,11 +50,14 @@
 #include "../presenter/apppresenter.h"
 #include "../presenter/display.h"
 #include "../presenter/dfmsocketinterface.h"
+#include "../presenter/dfminitializer.h"
 #include "../desktop.h"
 #include "../config/config.h"
 
 #include "canvasviewhelper.h"
+#include "../model/desktopwatcher.h"
 #include "util/xcb/xcb.h"
+#include "util/trace/trace.h"
 #include "private/canvasviewprivate.h"
 
 static inline bool isPersistFile(const DUrl &url)
@@ -96,7 +99,7 @@ CanvasGridView::CanvasGridView(QWidget *parent)
 
 CanvasGridView::~CanvasGridView()
 {
-
+    delete d->snapshot;
 }
 
 QRect CanvasGridView::visualRect(const QModelIndex &index) const
@@ -112,10 +115,10 @@ QRect CanvasGridView::visualRect(const QModelIndex &index) const
 QModelIndex CanvasGridView::indexAt(const QPoint &point) const
 {
     auto gridPos = gridAt(point);
-    auto localFile =  GridManager::instance()->itemId(gridPos.x(), gridPos.y());
-    auto rowIndex = model()->index(DUrl::fromLocalFile(localFile));
+    auto item = GridManager::instance()->item(gridPos.x(), gridPos.y());
+    auto rowIndex = indexOfItem(item);
     QPoint pos = QPoint(point.x() + horizontalOffset(), point.y() + verticalOffset());
-    auto list = itemPaintGeomertys(rowIndex);
+    auto list = itemPaintGeomertys(item, rowIndex);
 
     for (QModelIndex &index : itemDelegate()->hasWidgetIndexs()) {
         if (index == itemDelegate()->editingIndex()) {
@@ -240,8 +243,8 @@ QModelIndex CanvasGridView::moveCursorGrid(CursorAction cursorAction, Qt::Keyboa
                     pos = newCoord.position();
                 }
                 if (!GridManager::instance()->isEmpty(pos.x(), pos.y())) {
-                    auto localFile = GridManager::instance()->itemId(pos.x(), pos.y());
-                    auto index = model()->index(DUrl::fromLocalFile(localFile));
+                    auto item = GridManager::instance()->item(pos.x(), pos.y());
+                    auto index = indexOfItem(item);
 
                     QItemSelectionRange selectionRange(index);
                     selection.push_back(selectionRange);
@@ -263,8 +266,8 @@ QModelIndex CanvasGridView::moveCursorGrid(CursorAction cursorAction, Qt::Keyboa
                     pos = newCoord.position();
                 }
                 if (!GridManager::instance()->isEmpty(pos.x(), pos.y())) {
-                    auto localFile = GridManager::instance()->itemId(pos.x(), pos.y());
-                    auto index = model()->index(DUrl::fromLocalFile(localFile));
+                    auto item = GridManager::instance()->item(pos.x(), pos.y());
+                    auto index = indexOfItem(item);
 
                     QItemSelectionRange selectionRange(index);
                     selection.push_back(selectionRange);
@@ -281,8 +284,8 @@ QModelIndex CanvasGridView::moveCursorGrid(CursorAction cursorAction, Qt::Keyboa
         return current;
     }
 
-    auto localFile =  GridManager::instance()->itemId(pos.x(), pos.y());
-    auto newIndex = model()->index(DUrl::fromLocalFile(localFile));
+    auto item = GridManager::instance()->item(pos.x(), pos.y());
+    auto newIndex = indexOfItem(item);
     if (newIndex.isValid()) {
         return newIndex;
     }
@@ -511,6 +514,7 @@ void CanvasGridView::keyPressEvent(QKeyEvent *event)
             return;
         case Qt::Key_Delete:
             if (canDeleted && !selectUrls.contains(rootUrl.toString())) {
+                DFMInitializer::instance()->ensure(DFMInitializer::FileOperationReady);
                 DFileService::instance()->moveToTrash(fmevent);
             }
             break;
@@ -524,6 +528,7 @@ void CanvasGridView::keyPressEvent(QKeyEvent *event)
                 return;
             }
 
+            DFMInitializer::instance()->ensure(DFMInitializer::FileOperationReady);
             DFileService::instance()->deleteFiles(fmevent);
 
             return;
@@ -661,7 +666,8 @@ void CanvasGridView::dropEvent(QDropEvent *event)
 
     QModelIndex targetIndex = indexAt(event->pos());
 
-    QStringList selectLocalFiles;
+    QList<ItemHandle> selectItems;
+    auto registry = ItemRegistry::instance();
     auto selects = selectionModel()->selectedIndexes();
     bool canMove = true;
     for (auto index : selects) {
@@ -672,7 +678,7 @@ void CanvasGridView::dropEvent(QDropEvent *event)
         if (targetIndex == index) {
             canMove = false;
         }
-        selectLocalFiles << info->fileUrl().toLocalFile();
+        selectItems << registry->find(info->fileUrl().toLocalFile());
     }
 
     DAbstractFileInfoPointer targetInfo = model()->fileInfo(indexAt(event->pos()));
@@ -727,8 +733,10 @@ void CanvasGridView::dropEvent(QDropEvent *event)
                 auto point = event->pos();
                 auto row = (point.x() - d->viewMargins.left()) / d->cellWidth;
                 auto col = (point.y() - d->viewMargins.top()) / d->cellHeight;
-                auto current = model()->fileInfo(d->currentCursorIndex)->fileUrl().toLocalFile();
-                GridManager::instance()->move(selectLocalFiles, current, row, col);
+                auto currentFile = model()->fileInfo(d->currentCursorIndex)->fileUrl().toLocalFile();
+                auto current = registry->find(currentFile);
+                GridManager::instance()->move(selectItems, current, row, col);
+                d->scheduleSnapshot();
                 setState(NoState);
                 itemDelegate()->hideNotEditingIndexWidget();
                 DUtil::TimerSingleShot(20, [this]() {
@@ -745,6 +753,8 @@ void CanvasGridView::dropEvent(QDropEvent *event)
 
         if (model()->supportedDropActions() & event->dropAction() && model()->flags(targetIndex) & Qt::ItemIsDropEnabled) {
             const Qt::DropAction action = dragDropMode() == InternalMove ? Qt::MoveAction : event->dropAction();
+            // dropping copies or moves the files through the file service
+            DFMInitializer::instance()->ensure(DFMInitializer::FileOperationReady);
             if (model()->dropMimeData(event->mimeData(), action, targetIndex.row(), targetIndex.column(), targetIndex)) {
                 if (action != event->dropAction()) {
                     event->setDropAction(action);
@@ -771,6 +781,13 @@ void CanvasGridView::paintEvent(QPaintEvent *event)
 //    }
 //    d->lastRepaintTime = currentTime;
 
+    // the first frame is a startup milestone
+    Trace::Scope firstPaintScope("CanvasGridView::firstPaint", !d->painted);
+    if (!d->painted) {
+        d->painted = true;
+        emit windowMapped();
+    }
+
     QPainter painter(viewport());
     auto repaintRect = event->rect();
 //    painter.setRenderHints(QPainter::Antialiasing | QPainter::HighQualityAntialiasing);
@@ -804,6 +821,24 @@ void CanvasGridView::paintEvent(QPaintEvent *event)
     }
 #endif
 
+    // the desktop is still being enumerated, show the icons of the last
+    // session under the cells the model has not delivered yet
+    if (d->snapshot->matches(snapshotGeometry())) {
+        auto grid = GridManager::instance();
+        d->snapshot->paint(&painter, repaintRect, [ = ](const DesktopSnapshot::Tile & tile) {
+            return grid->isInited() && indexOfItem(grid->item(tile.cell.x(), tile.cell.y())).isValid();
+        });
+        markIconsVisible();
+        if (!grid->isInited()) {
+            return;
+        }
+    }
+
+    // the real icons are up, load the rest of DFMGlobal in idle time
+    DFMInitializer::instance()->start();
+    if (GridManager::instance()->isInited()) {
+        markIconsVisible();
+    }
 
     if (d->dragMoveHoverIndex.isValid() && d->dragMoveHoverIndex != d->currentCursorIndex) {
         QPainterPath path;
@@ -813,31 +848,29 @@ void CanvasGridView::paintEvent(QPaintEvent *event)
         painter.strokePath(path, QColor(30, 126, 255, 0.20 * 255));
     }
 
-    QStringList repaintLocalFiles;
+    QVector<ItemHandle> repaintItems;
+    repaintItems.reserve(d->colCount * d->rowCount);
     for (int x = 0; x < d->colCount; ++x) {
         for (int y = 0; y < d->rowCount; ++y) {
-            auto localFile = GridManager::instance()->itemId(x, y);
-            if (!localFile.isEmpty()) {
-                repaintLocalFiles << localFile;
+            auto item = GridManager::instance()->item(x, y);
+            if (item != ItemRegistry::InvalidHandle) {
+                repaintItems << item;
             }
         }
     }
 
-    auto overlayItems = GridManager::instance()->overlapItems();
+    auto &overlayItems = GridManager::instance()->overlapItems();
     for (int i = 0; i < 10 && i < overlayItems.length(); ++i) {
-        auto localFile = overlayItems.value(i);
-        if (!localFile.isEmpty()) {
-            repaintLocalFiles << localFile;
-        }
+        repaintItems << overlayItems.value(i);
     }
 
 //    int drawCount = 0;
-    for (auto &localFile : repaintLocalFiles) {
-        auto index = model()->index(DUrl::fromLocalFile(localFile));
+    for (auto item : repaintItems) {
+        auto index = indexOfItem(item);
         if (!index.isValid()) {
             continue;
         }
-        option.rect = visualRect(index);
+        option.rect = itemRect(item);
         bool needflash = false;
         for (auto &rr : event->region().rects())
             if (rr.intersects(option.rect)) {
@@ -942,6 +975,8 @@ void CanvasGridView::focusInEvent(QFocusEvent *event)
 
 void CanvasGridView::contextMenuEvent(QContextMenuEvent *event)
 {
+    // menus need plugins, extensions, mime apps and dialogs
+    DFMInitializer::instance()->ensure(DFMInitializer::MenuReady);
 
     const QModelIndex &index = indexAt(event->pos());
     bool indexIsSelected = selectionModel()->isSelected(index);
@@ -1028,6 +1063,12 @@ bool CanvasGridView::setCurrentUrl(const DUrl &url)
         return false;
     }
 
+    // reconcile the grid with the model once it has listed the directory
+    if (fileUrl.isLocalFile()) {
+        d->reconcileTimer->start();
+    }
+
+    Trace::instant("model: set root url");
     QModelIndex index = model()->setRootUrl(fileUrl);
     setRootIndex(index);
 
@@ -1044,37 +1085,67 @@ bool CanvasGridView::setCurrentUrl(const DUrl &url)
 
     model()->setFilters(model()->filters() & ~QDir::Hidden);
 
-    if (d->filesystemWatcher) {
-        d->filesystemWatcher->deleteLater();
+    watchDesktop(fileUrl.toLocalFile());
+    return true;
+}
+
+void CanvasGridView::watchDesktop(const QString &path)
+{
+    d->rewatchTimer->stop();
+    if (d->desktopWatcher) {
+        // a drain may still run before the deferred delete
+        d->desktopWatcher->disconnect(this);
+        d->desktopWatcher->deleteLater();
     }
 
-    d->filesystemWatcher = new DFileSystemWatcher(QStringList() << fileUrl.toLocalFile());
+    // one watch on the directory instead of one per item
+    d->desktopWatcher = new DesktopWatcher(path, this);
+    if (!d->desktopWatcher->isWatching() && !QFileInfo(path).isDir()) {
+        d->rewatchTimer->start();
+    }
 
-    connect(d->filesystemWatcher, &DFileSystemWatcher::fileCreated,
-    this, [ = ](const QString & path, const QString & name) {
-//        qDebug() << path << name;
-        const QString &filePath = path + QDir::separator() + name;
-        if (filePath.endsWith(".desktop")) {
-            d->filesystemWatcher->addPath(filePath);
+    auto refresh = [ = ](const QString & localFile) {
+        auto index = model()->index(DUrl::fromLocalFile(localFile));
+        auto info = model()->fileInfo(index);
+        if (info) {
+            info->refresh();
         }
+    };
+
+    connect(d->desktopWatcher, &DesktopWatcher::fileClosed, this, refresh);
+    connect(d->desktopWatcher, &DesktopWatcher::fileAttributeChanged, this, refresh);
+    // editors save by renaming a temporary file over the original
+    connect(d->desktopWatcher, &DesktopWatcher::fileMoved,
+    this, [ = ](const QString & from, const QString & to) {
+        GridManager::instance()->noteMove(from, to);
+        if (!to.isEmpty()) {
+            refresh(to);
+        }
+    });
+    // the kernel queue overflowed, closes and renames were lost
+    connect(d->desktopWatcher, &DesktopWatcher::overflowed, this, &CanvasGridView::rescanDesktop);
+    // the watch died with the directory, try again once it is back
+    connect(d->desktopWatcher, &DesktopWatcher::directoryGone, this, [ = ]() {
+        qWarning() << "desktop directory gone" << path;
+        d->rewatchTimer->start();
     });
+}
 
-    connect(d->filesystemWatcher, &DFileSystemWatcher::fileClosed,
-    this, [ = ](const QString & path, const QString & /*name*/) {
-//        qDebug() << path << name;
-        auto index = model()->index(DUrl::fromLocalFile(path));
-        auto info = model()->fileInfo(index);
+void CanvasGridView::rescanDesktop()
+{
+    auto root = rootIndex();
+    for (int i = 0; i < model()->rowCount(root); ++i) {
+        auto info = model()->fileInfo(model()->index(i, 0, root));
         if (info) {
             info->refresh();
         }
-    });
+    }
 
-    connect(d->filesystemWatcher, &DFileSystemWatcher::fileDeleted,
-    this, [ = ](const QString & path, const QString & /*name*/) {
-//        qDebug() << path << name;
-        d->filesystemWatcher->removePath(path);
-    });
-    return true;
+    // reconcile the grid with what the model ends up with
+    if (!currentUrl().toLocalFile().isEmpty()) {
+        d->reconcileTimer->start();
+    }
+    update();
 }
 
 bool CanvasGridView::setRootUrl(const DUrl &url)
@@ -1152,6 +1223,9 @@ bool CanvasGridView::edit(const QModelIndex &index, QAbstractItemView::EditTrigg
         }
     }
 
+    // the editor commits the new name as a rename through the file service
+    DFMInitializer::instance()->ensure(DFMInitializer::FileOperationReady);
+
     if (QWidget *w = indexWidget(index)) {
         Qt::ItemFlags flags = model()->flags(index);
         if (((flags & Qt::ItemIsEditable) == 0) || ((flags & Qt::ItemIsEnabled) == 0)) {
@@ -1221,16 +1295,18 @@ void CanvasGridView::initUI()
     delegate->setFocusTextBackgroundBorderColor(Qt::white);
     setItemDelegate(delegate);
 
-    auto settings = Config::instance()->settings();
-    settings->beginGroup(Config::groupGeneral);
-    if (settings->contains(Config::keyIconLevel)) {
-        auto iconSizeLevel = settings->value(Config::keyIconLevel).toInt();
+    auto config = Config::instance()->snapshot();
+    if (config->contains(Config::groupGeneral, Config::keyIconLevel)) {
+        auto iconSizeLevel = config->value(Config::groupGeneral, Config::keyIconLevel).toInt();
         itemDelegate()->setIconSizeByIconSizeLevel(iconSizeLevel);
         qDebug() << "current icon size level" << itemDelegate()->iconSizeLevel();
     } else {
         itemDelegate()->setIconSizeByIconSizeLevel(0);
     }
-    settings->endGroup();
+
+    auto cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    d->snapshot = new DesktopSnapshot(cachePath + "/desktop.snapshot");
+    d->snapshot->load();
 
     DFMSocketInterface::instance();
 }
@@ -1267,8 +1343,37 @@ void CanvasGridView::updateGeometry(const QRect &geometry)
 
 void CanvasGridView::initConnection()
 {
+    // the model may never settle on Idle, give up waiting after a while
+    d->reconcileTimer = new QTimer(this);
+    d->reconcileTimer->setSingleShot(true);
+    d->reconcileTimer->setInterval(10000);
+    connect(d->reconcileTimer, &QTimer::timeout, this, &CanvasGridView::reconcileGrid);
+
+    d->rewatchTimer = new QTimer(this);
+    d->rewatchTimer->setSingleShot(true);
+    d->rewatchTimer->setInterval(2000);
+    connect(d->rewatchTimer, &QTimer::timeout, this, [ = ]() {
+        auto path = currentUrl().toLocalFile();
+        if (!QFileInfo(path).isDir()) {
+            d->rewatchTimer->start();
+            return;
+        }
+        qDebug() << "desktop directory back" << path;
+        watchDesktop(path);
+        rescanDesktop();
+    });
+
+    // file bursts are applied to the grid as one transaction per window
+    d->transactionTimer = new QTimer(this);
+    d->transactionTimer->setSingleShot(true);
+    connect(d->transactionTimer, &QTimer::timeout, this, &CanvasGridView::commitLayoutTransaction);
+
     d->syncTimer = new QTimer(this);
     connect(d->syncTimer, &QTimer::timeout, this, [ = ]() {
+        if (d->reconcileTimer->isActive() && isModelPopulated()) {
+            d->reconcileTimer->stop();
+            reconcileGrid();
+        }
         this->update();
         auto interval = d->syncTimer->interval() + 800;
         if (interval > 10000) {
@@ -1278,6 +1383,18 @@ void CanvasGridView::initConnection()
     });
     d->syncTimer->start();
 
+    d->snapshotTimer = new QTimer(this);
+    d->snapshotTimer->setSingleShot(true);
+    d->snapshotTimer->setInterval(5000);
+    connect(d->snapshotTimer, &QTimer::timeout, this, &CanvasGridView::saveSnapshot);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [ = ]() {
+        if (d->snapshotTimer->isActive()) {
+            d->snapshotTimer->stop();
+            saveSnapshot();
+        }
+        DesktopSnapshot::waitForSaves();
+    });
+
     connect(Display::instance()->primaryScreen(), &QScreen::availableGeometryChanged,
     this, [ = ](const QRect & geometry) {
         qDebug() << "Init primaryScreen availableGeometryChanged changed to:" << geometry;
@@ -1309,26 +1426,21 @@ void CanvasGridView::initConnection()
         updateGeometry(screen->availableGeometry());
     });
 
+    connect(GridManager::instance(), &GridManager::layoutChanged,
+    this, [ = ]() {
+        this->update();
+        d->scheduleSnapshot();
+    });
+
     connect(this->model(), &QAbstractItemModel::rowsInserted,
     this, [ = ](const QModelIndex & parent, int first, int last) {
 //        qDebug() << parent << first << last;
-
-        if (d->filesystemWatcher) {
-            QStringList files;
-            for (int i = first; i <= last; ++i) {
-                auto index = model()->index(i, 0, parent);
-                if (!index.isValid()) {
-                    continue;
-                }
-                auto localFile = model()->getUrlByIndex(index).toLocalFile();
-
-                files << localFile;
-            }
-//            qDebug() << "add watch" << files;
-            d->filesystemWatcher->addPaths(files);
-        }
+        Trace::instant("model: rows inserted");
 
         if (!GridManager::instance()->isInited()) {
+            Trace::instant("model: first rows inserted");
+            // items of later batches get the cells their profile entries
+            // keep free until the model has listed everything
             QStringList files;
             for (int i = first; i <= last; ++i) {
                 auto index = model()->index(i, 0, parent);
@@ -1337,21 +1449,24 @@ void CanvasGridView::initConnection()
             }
             qDebug() << "init GridManager cells";
             GridManager::instance()->initProfile(files);
+            rebuildItemIndexes();
+            d->scheduleSnapshot();
+            update();
             return;
         }
 
+        QStringList files;
         for (int i = first; i <= last; ++i) {
             auto index = model()->index(i, 0, parent);
-            auto localFile = model()->getUrlByIndex(index).toLocalFile();
-            qDebug() << "add" << localFile;
-            GridManager::instance()->add(localFile);
+            files << model()->getUrlByIndex(index).toLocalFile();
         }
-        d->quickSync();
+        queueLayoutChange(files, true);
     });
     connect(this->model(), &QAbstractItemModel::rowsAboutToBeRemoved,
     this, [ = ](const QModelIndex & parent, int first, int last) {
 
         qDebug() << model()->getUrlByIndex(parent).toLocalFile();
+        QStringList files;
         for (int i = first; i <= last; ++i) {
             auto index = model()->index(i, 0, parent);
             if (d->currentCursorIndex == index) {
@@ -1361,17 +1476,15 @@ void CanvasGridView::initConnection()
             }
 
             auto localFile = model()->getUrlByIndex(index).toLocalFile();
-            qDebug() << "rowsAboutToBeRemoved" << localFile;
-            GridManager::instance()->remove(localFile);
+            d->itemIndexes.remove(ItemRegistry::instance()->find(localFile));
+            files << localFile;
         }
+        queueLayoutChange(files, false);
     });
-    connect(this->model(), &QAbstractItemModel::rowsRemoved,
-    this, [ = ](const QModelIndex & /*parent*/, int /*first*/, int /*last*/) {
-        if (GridManager::instance()->autoAlign()) {
-            GridManager::instance()->reAlign();
-        }
-        d->quickSync();
-    });
+    connect(this->model(), &QAbstractItemModel::modelReset,
+            this, &CanvasGridView::rebuildItemIndexes);
+    connect(this->model(), &QAbstractItemModel::layoutChanged,
+            this, &CanvasGridView::rebuildItemIndexes);
     connect(this->model(), &QAbstractItemModel::dataChanged,
             this, [ = ](const QModelIndex & topLeft,
                         const QModelIndex & bottomRight,
@@ -1382,6 +1495,7 @@ void CanvasGridView::initConnection()
             qDebug() << "resort desktop icons";
             model()->setEnabledSort(false);
             d->resortCount--;
+            commitLayoutTransaction();
             GridManager::instance()->clear();
             QStringList list;
             for (int i = 0; i < model()->rowCount(); ++i) {
@@ -1389,13 +1503,13 @@ void CanvasGridView::initConnection()
                 auto localFile = model()->getUrlByIndex(index).toLocalFile();
                 list << localFile;
             }
-            for (auto lf : list) {
-                GridManager::instance()->add(lf);
-            }
+            GridManager::instance()->addBatch(list);
             GridManager::instance()->reAlign();
+            rebuildItemIndexes();
         }
 
         d->quickSync();
+        d->scheduleSnapshot();
     });
 
     connect(this, &CanvasGridView::doubleClicked,
@@ -1414,6 +1528,7 @@ void CanvasGridView::initConnection()
         if (info.isDir()) {
             QProcess::startDetached("gvfs-open", QStringList() << url.toLocalFile());
         } else {
+            DFMInitializer::instance()->ensure(DFMInitializer::OpenFileReady);
             DFileService::instance()->openFile(url);
         }
     }, Qt::QueuedConnection);
@@ -1447,10 +1562,266 @@ void CanvasGridView::updateCanvas()
 
     d->updateCanvasSize(d->canvasRect.size(), geometryMargins, itemSize);
     GridManager::instance()->updateGridSize(d->colCount, d->rowCount);
+    d->scheduleSnapshot();
 
     repaint();
 }
 
+void CanvasGridView::queueLayoutChange(const QStringList &files, bool added)
+{
+    if (files.isEmpty()) {
+        return;
+    }
+
+    // the last change of a file within the window wins
+    for (auto &file : files) {
+        if (!d->pendingChanges.contains(file)) {
+            d->pendingOrder << file;
+        }
+        d->pendingChanges.insert(file, added);
+    }
+    ++d->pendingEvents;
+
+    // wait one more frame, but never past the window cap
+    if (!d->transactionTimer->isActive()) {
+        d->transactionAge.start();
+    }
+    auto remaining = CanvasViewPrivate::TransactionWindow - d->transactionAge.elapsed();
+    d->transactionTimer->start(qBound<qint64>(0, remaining, CanvasViewPrivate::TransactionFrame));
+}
+
+quint64 CanvasGridView::layoutTransactions() const
+{
+    return d->transactionCount;
+}
+
+quint64 CanvasGridView::coalescedLayoutEvents() const
+{
+    return d->coalescedEvents;
+}
+
+void CanvasGridView::commitLayoutTransaction()
+{
+    d->transactionTimer->stop();
+    if (0 == d->pendingEvents) {
+        return;
+    }
+
+    QStringList removed;
+    QStringList added;
+    for (auto &file : d->pendingOrder) {
+        if (d->pendingChanges.value(file)) {
+            added << file;
+        } else {
+            removed << file;
+        }
+    }
+
+    auto events = d->pendingEvents;
+    auto age = d->transactionAge.elapsed();
+    d->pendingChanges.clear();
+    d->pendingOrder.clear();
+    d->pendingEvents = 0;
+
+    auto begin = Trace::now();
+    GridManager::instance()->applyBatch(removed, added);
+    updateItemIndexes(added);
+    Trace::complete("layout transaction", begin, Trace::now() - begin);
+
+    ++d->transactionCount;
+    d->coalescedEvents += events;
+    Trace::counter("layout transaction events", events);
+    qDebug() << "layout transaction of" << events << "model events:"
+             << removed.length() << "removed," << added.length() << "added, window"
+             << age << "ms, average" << double(d->coalescedEvents) / d->transactionCount
+             << "events per transaction";
+
+    d->quickSync();
+    d->scheduleSnapshot();
+    update();
+}
+
+void CanvasGridView::updateItemIndexes(const QStringList &files)
+{
+    auto registry = ItemRegistry::instance();
+    for (auto &file : files) {
+        auto item = registry->find(file);
+        if (item == ItemRegistry::InvalidHandle) {
+            continue;
+        }
+        auto index = model()->index(DUrl::fromLocalFile(file));
+        if (index.isValid()) {
+            d->itemIndexes.insert(item, index);
+        } else {
+            d->itemIndexes.remove(item);
+        }
+    }
+}
+
+// after the grid re-interned its items, or the model moved its rows
+void CanvasGridView::rebuildItemIndexes()
+{
+    d->itemIndexes.clear();
+
+    auto registry = ItemRegistry::instance();
+    auto root = rootIndex();
+    for (int i = 0; i < model()->rowCount(root); ++i) {
+        auto index = model()->index(i, 0, root);
+        auto item = registry->find(model()->getUrlByIndex(index).toLocalFile());
+        if (item != ItemRegistry::InvalidHandle) {
+            d->itemIndexes.insert(item, index);
+        }
+    }
+}
+
+QStringList CanvasGridView::modelFiles() const
+{
+    QStringList files;
+    auto root = rootIndex();
+    for (int i = 0; i < model()->rowCount(root); ++i) {
+        files << model()->getUrlByIndex(model()->index(i, 0, root)).toLocalFile();
+    }
+    return files;
+}
+
+bool CanvasGridView::isModelPopulated() const
+{
+    return model()->state() == DFileSystemModel::Idle
+           && model()->rowCount(rootIndex()) > 0;
+}
+
+void CanvasGridView::reconcileGrid()
+{
+    commitLayoutTransaction();
+
+    auto files = modelFiles();
+    qDebug() << "model populated with" << files.length() << "items";
+    Trace::instant("model: populated");
+
+    // rows the batches missed, and once the model has finished loading,
+    // placed items it does not have
+    auto grid = GridManager::instance();
+    if (!grid->isInited()) {
+        grid->initProfile(files);
+    } else {
+        QStringList gone;
+        if (model()->state() == DFileSystemModel::Idle) {
+            auto modelSet = files.toSet();
+            for (auto &id : grid->itemIds()) {
+                if (!modelSet.contains(id)) {
+                    gone << id;
+                }
+            }
+        }
+        grid->applyBatch(gone, files);
+    }
+    // saved cells nobody claimed by now belong to files that are gone
+    grid->settleProfile();
+    rebuildItemIndexes();
+
+    d->snapshot->clear();
+    d->scheduleSnapshot();
+    update();
+}
+
+void CanvasGridView::markIconsVisible()
+{
+    if (d->iconsVisible) {
+        return;
+    }
+    d->iconsVisible = true;
+    emit iconsVisible();
+}
+
+DesktopSnapshot::Geometry CanvasGridView::snapshotGeometry() const
+{
+    DesktopSnapshot::Geometry geometry;
+    geometry.colCount = d->colCount;
+    geometry.rowCount = d->rowCount;
+    geometry.cellSize = QSize(d->cellWidth, d->cellHeight);
+    geometry.tileSize = QRect(0, 0, d->cellWidth, d->cellHeight).marginsRemoved(d->cellMargins).size();
+    geometry.origin = QPoint(d->viewMargins.left(), d->viewMargins.top());
+    geometry.iconLevel = itemDelegate()->iconSizeLevel();
+    return geometry;
+}
+
+void CanvasGridView::saveSnapshot()
+{
+    if (!GridManager::instance()->isInited()) {
+        return;
+    }
+    // not the desktop yet, maybe a second instance about to quit
+    if (!Config::instance()->isPersistent()) {
+        d->scheduleSnapshot();
+        return;
+    }
+    // a half populated model would save a half empty desktop
+    if (d->reconcileTimer->isActive()) {
+        d->scheduleSnapshot();
+        return;
+    }
+
+    auto geometry = snapshotGeometry();
+    auto path = d->snapshot->path();
+
+    QVector<DesktopSnapshot::Tile> tiles;
+    QModelIndexList indexes;
+    for (int x = 0; x < d->colCount; ++x) {
+        for (int y = 0; y < d->rowCount; ++y) {
+            auto item = GridManager::instance()->item(x, y);
+            auto index = indexOfItem(item);
+            if (!index.isValid()) {
+                continue;
+            }
+            DesktopSnapshot::Tile tile;
+            tile.localFile = model()->getUrlByIndex(index).toLocalFile();
+            tile.cell = QPoint(x, y);
+            tile.rect = itemRect(item);
+            tiles << tile;
+            indexes << index;
+        }
+    }
+
+    // nothing moved, was added or renamed since the last save
+    if (d->snapshotSaved && geometry == d->savedGeometry && tiles == d->savedTiles) {
+        return;
+    }
+    d->snapshotSaved = true;
+    d->savedGeometry = geometry;
+    d->savedTiles = tiles;
+
+    if (tiles.isEmpty()) {
+        QFile::remove(path);
+        return;
+    }
+
+    auto tileSize = geometry.tileSize;
+    QImage atlas(tileSize.width(), tileSize.height() * tiles.size(),
+                 QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+
+    // render every tile exactly like paintEvent, shifted into its atlas row
+    auto option = viewOptions();
+    option.textElideMode = Qt::ElideMiddle;
+    option.state &= ~(QStyle::State_Selected | QStyle::State_HasFocus | QStyle::State_MouseOver);
+
+    QPainter painter(&atlas);
+    for (int i = 0; i < tiles.size(); ++i) {
+        auto origin = tiles.at(i).rect.topLeft();
+        painter.save();
+        painter.setClipRect(QRect(QPoint(0, i * tileSize.height()), tileSize));
+        painter.translate(-origin.x(), i * tileSize.height() - origin.y());
+        option.rect = tiles.at(i).rect.marginsRemoved(QMargins(2, 0, 2, 0));
+        this->itemDelegate()->paint(&painter, option, indexes.at(i));
+        painter.restore();
+    }
+    painter.end();
+
+    // the delegate paints on the GUI thread, encoding and writing do not
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    DesktopSnapshot::saveLater(path, geometry, tiles, atlas);
+}
+
 void CanvasGridView::increaseIcon()
 {
     // TODO: 3 is 128*128, 0,1,2,3
@@ -1486,6 +1857,14 @@ inline QRect CanvasGridView::gridRectAt(const QPoint &pos) const
     return QRect(x, y, d->cellWidth, d->cellHeight).marginsRemoved(d->cellMargins);
 }
 
+inline QRect CanvasGridView::itemRect(ItemHandle item) const
+{
+    auto gridPos = GridManager::instance()->position(item);
+    auto x = gridPos.x() * d->cellWidth + d->viewMargins.left();
+    auto y = gridPos.y() * d->cellHeight + d->viewMargins.top();
+    return QRect(x, y, d->cellWidth, d->cellHeight).marginsRemoved(d->cellMargins);
+}
+
 inline QList<QRect> CanvasGridView::itemPaintGeomertys(const QModelIndex &index) const
 {
     QStyleOptionViewItem option = viewOptions();
@@ -1493,16 +1872,29 @@ inline QList<QRect> CanvasGridView::itemPaintGeomertys(const QModelIndex &index)
     return itemDelegate()->paintGeomertys(option, index);
 }
 
+inline QList<QRect> CanvasGridView::itemPaintGeomertys(ItemHandle item, const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return QList<QRect>();
+    }
+    QStyleOptionViewItem option = viewOptions();
+    option.rect = itemRect(item);
+    return itemDelegate()->paintGeomertys(option, index);
+}
+
 inline QModelIndex CanvasGridView::firstIndex()
 {
-    auto localFile = GridManager::instance()->firstItemId();
-    return model()->index(DUrl::fromLocalFile(localFile));
+    return indexOfItem(GridManager::instance()->firstItem());
 }
 
 inline QModelIndex CanvasGridView::lastIndex()
 {
-    auto localFile = GridManager::instance()->lastItemId();
-    return model()->index(DUrl::fromLocalFile(localFile));
+    return indexOfItem(GridManager::instance()->lastItem());
+}
+
+inline QModelIndex CanvasGridView::indexOfItem(ItemHandle item) const
+{
+    return d->itemIndexes.value(item);
 }
 
 void CanvasGridView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command, bool byIconRect)
@@ -1548,12 +1940,12 @@ void CanvasGridView::setSelection(const QRect &rect, QItemSelectionModel::Select
 
     for (auto x = topLeftGridPos.x(); x <= bottomRightGridPos.x(); ++x) {
         for (auto y = topLeftGridPos.y(); y <= bottomRightGridPos.y(); ++y) {
-            auto localFile = GridManager::instance()->itemId(x, y);
-            if (localFile.isEmpty()) {
+            auto item = GridManager::instance()->item(x, y);
+            if (item == ItemRegistry::InvalidHandle) {
                 continue;
             }
-            auto index = model()->index(DUrl::fromLocalFile(localFile));
-            auto list = QList<QRect>() << itemPaintGeomertys(index);
+            auto index = indexOfItem(item);
+            auto list = QList<QRect>() << itemPaintGeomertys(item, index);
             for (const QRect &r : list) {
                 if (selectRect.intersects(r)) {
                     QItemSelectionRange selectionRange(index);
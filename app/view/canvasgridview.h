@@ -14,6 +14,9 @@
 #include <QScopedPointer>
 #include <dfilemenumanager.h>
 
+#include "../model/itemregistry.h"
+#include "desktopsnapshot.h"
+
 class DUrl;
 class DStyledItemDelegate;
 class DFileSystemModel;
@@ -83,11 +86,19 @@ public:
     DStyledItemDelegate *itemDelegate() const;
     void setItemDelegate(DStyledItemDelegate *delegate);
 
+    // layout transactions applied and the model events folded into them
+    quint64 layoutTransactions() const;
+    quint64 coalescedLayoutEvents() const;
+
 signals:
     void sortRoleChanged(int role, Qt::SortOrder order);
     void autoAlignToggled();
     void changeIconLevel(int iconLevel);
 
+    // startup milestones, emitted once from paintEvent
+    void windowMapped();
+    void iconsVisible();
+
 public slots:
     bool edit(const QModelIndex &index, EditTrigger trigger, QEvent *event) Q_DECL_OVERRIDE;
 
@@ -99,15 +110,35 @@ private:
     void updateGeometry(const QRect &geometry);
     void updateCanvas();
 
+    void queueLayoutChange(const QStringList &files, bool added);
+    void commitLayoutTransaction();
+
+    void updateItemIndexes(const QStringList &files);
+    void rebuildItemIndexes();
+
+    QStringList modelFiles() const;
+    bool isModelPopulated() const;
+    void reconcileGrid();
+
+    void watchDesktop(const QString &path);
+    void rescanDesktop();
+
+    void markIconsVisible();
+    DesktopSnapshot::Geometry snapshotGeometry() const;
+    void saveSnapshot();
+
     void increaseIcon();
     void decreaseIcon();
 
     inline QPoint gridAt(const QPoint &pos) const;
     inline QRect gridRectAt(const QPoint &pos) const;
+    inline QRect itemRect(ItemHandle item) const;
     inline QList<QRect> itemPaintGeomertys(const QModelIndex &index) const;
+    inline QList<QRect> itemPaintGeomertys(ItemHandle item, const QModelIndex &index) const;
 
     inline QModelIndex firstIndex();
     inline QModelIndex lastIndex();
+    inline QModelIndex indexOfItem(ItemHandle item) const;
 
     void setSelection(const QRect &rect,
                       QItemSelectionModel::SelectionFlags command,
@@ -0,0 +1,360 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#include "desktopsnapshot.h"
+
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDebug>
+
+#include <atomic>
+#include <string.h>
+
+#include "../config/atomicfile.h"
+
+namespace
+{
+const char SnapshotMagic[4] = {'D', 'D', 'S', 'N'};
+const quint8 SnapshotVersion = 1;
+
+// magic, version, grid geometry, tile count, atlas offset
+const int HeaderSize = 36;
+// cell x, cell y, rect x, rect y, name length
+const int TileHeadSize = 2 + 2 + 4 + 4 + 2;
+const int AtlasAlignment = 16;
+
+inline void putUInt16(QByteArray &buffer, quint16 value)
+{
+    buffer.append(static_cast<char>(value & 0xff));
+    buffer.append(static_cast<char>((value >> 8) & 0xff));
+}
+
+inline void putUInt32(QByteArray &buffer, quint32 value)
+{
+    putUInt16(buffer, value & 0xffff);
+    putUInt16(buffer, (value >> 16) & 0xffff);
+}
+
+inline quint16 getUInt16(const uchar *data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+inline quint32 getUInt32(const uchar *data)
+{
+    return getUInt16(data) | (static_cast<quint32>(getUInt16(data + 2)) << 16);
+}
+
+inline qint64 atlasBytes(const QSize &tileSize, int count)
+{
+    return static_cast<qint64>(tileSize.width()) * 4 * tileSize.height() * count;
+}
+
+// saves queued to the pool, written one at a time
+struct SaveQueue {
+    QMutex                  mutex;
+    QWaitCondition          idle;
+    int                     pending = 0;
+    QMutex                  writeMutex;
+    std::atomic<quint64>    latest {0};
+};
+
+SaveQueue &saveQueue()
+{
+    static SaveQueue queue;
+    return queue;
+}
+
+class SaveJob : public QRunnable
+{
+public:
+    SaveJob(quint64 generation, const QString &path, const DesktopSnapshot::Geometry &geometry,
+            const QVector<DesktopSnapshot::Tile> &tiles, const QImage &atlas)
+        : m_generation(generation), m_path(path), m_geometry(geometry), m_tiles(tiles), m_atlas(atlas)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        auto &queue = saveQueue();
+        {
+            QMutexLocker writeLock(&queue.writeMutex);
+            // a newer save is queued, it would replace this file anyway
+            if (m_generation == queue.latest.load()) {
+                DesktopSnapshot::save(m_path, m_geometry, m_tiles, m_atlas);
+            }
+        }
+
+        QMutexLocker lock(&queue.mutex);
+        if (0 == --queue.pending) {
+            queue.idle.wakeAll();
+        }
+    }
+
+private:
+    quint64                         m_generation;
+    QString                         m_path;
+    DesktopSnapshot::Geometry       m_geometry;
+    QVector<DesktopSnapshot::Tile>  m_tiles;
+    QImage                          m_atlas;
+};
+}
+
+bool DesktopSnapshot::Tile::operator==(const Tile &other) const
+{
+    return cell == other.cell && rect == other.rect && localFile == other.localFile;
+}
+
+bool DesktopSnapshot::Geometry::operator==(const Geometry &other) const
+{
+    return colCount == other.colCount && rowCount == other.rowCount
+           && cellSize == other.cellSize && tileSize == other.tileSize
+           && origin == other.origin && iconLevel == other.iconLevel;
+}
+
+DesktopSnapshot::DesktopSnapshot(const QString &path)
+    : m_path(path)
+{
+}
+
+DesktopSnapshot::~DesktopSnapshot()
+{
+    clear();
+}
+
+const QString &DesktopSnapshot::path() const
+{
+    return m_path;
+}
+
+bool DesktopSnapshot::load()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    clear();
+
+    m_file.setFileName(m_path);
+    if (!m_file.exists()) {
+        return false;
+    }
+
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "open desktop snapshot failed" << m_path << m_file.errorString();
+        return false;
+    }
+
+    auto size = m_file.size();
+    if (size < HeaderSize) {
+        m_file.close();
+        return false;
+    }
+
+    m_data = m_file.map(0, size);
+    if (!m_data) {
+        qWarning() << "map desktop snapshot failed" << m_path << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    if (0 != memcmp(m_data, SnapshotMagic, sizeof(SnapshotMagic)) || m_data[4] != SnapshotVersion) {
+        qWarning() << "unknown desktop snapshot format, discard" << m_path;
+        clear();
+        return false;
+    }
+
+    Geometry geometry;
+    geometry.colCount = getUInt16(m_data + 8);
+    geometry.rowCount = getUInt16(m_data + 10);
+    geometry.cellSize = QSize(getUInt16(m_data + 12), getUInt16(m_data + 14));
+    geometry.tileSize = QSize(getUInt16(m_data + 16), getUInt16(m_data + 18));
+    geometry.iconLevel = getUInt16(m_data + 20);
+    geometry.origin = QPoint(getUInt16(m_data + 22), getUInt16(m_data + 24));
+    auto count = static_cast<int>(getUInt32(m_data + 28));
+    qint64 atlasOffset = getUInt32(m_data + 32);
+
+    if (geometry.tileSize.isEmpty() || atlasOffset % AtlasAlignment
+            || atlasOffset + atlasBytes(geometry.tileSize, count) != size) {
+        qWarning() << "broken desktop snapshot, discard" << m_path;
+        clear();
+        return false;
+    }
+
+    QVector<Tile> tiles;
+    tiles.reserve(count);
+    qint64 offset = HeaderSize;
+    for (int i = 0; i < count; ++i) {
+        if (offset + TileHeadSize > atlasOffset) {
+            break;
+        }
+        auto record = m_data + offset;
+        auto nameSize = getUInt16(record + 12);
+        if (offset + TileHeadSize + nameSize > atlasOffset) {
+            break;
+        }
+
+        Tile tile;
+        tile.cell = QPoint(getUInt16(record), getUInt16(record + 2));
+        tile.rect = QRect(QPoint(static_cast<qint32>(getUInt32(record + 4)),
+                                 static_cast<qint32>(getUInt32(record + 8))),
+                          geometry.tileSize);
+        tile.localFile = QString::fromUtf8(reinterpret_cast<const char *>(record + TileHeadSize), nameSize);
+        tiles << tile;
+        offset += TileHeadSize + nameSize;
+    }
+
+    if (tiles.size() != count) {
+        qWarning() << "broken desktop snapshot, discard" << m_path;
+        clear();
+        return false;
+    }
+
+    m_geometry = geometry;
+    m_tiles = tiles;
+    // the mapping is read only, keep the image on the const constructor
+    const uchar *atlas = m_data + atlasOffset;
+    m_atlas = QImage(atlas, geometry.tileSize.width(),
+                     geometry.tileSize.height() * count,
+                     geometry.tileSize.width() * 4, QImage::Format_ARGB32_Premultiplied);
+
+    qDebug() << "load desktop snapshot" << m_path << size << "bytes"
+             << count << "tiles in" << timer.elapsed() << "ms";
+    return true;
+}
+
+void DesktopSnapshot::clear()
+{
+    // the atlas refers to the mapping, release it first
+    m_atlas = QImage();
+    m_tiles.clear();
+    m_geometry = Geometry();
+
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool DesktopSnapshot::isValid() const
+{
+    return !m_atlas.isNull();
+}
+
+bool DesktopSnapshot::matches(const Geometry &geometry) const
+{
+    return isValid() && m_geometry == geometry;
+}
+
+const QVector<DesktopSnapshot::Tile> &DesktopSnapshot::tiles() const
+{
+    return m_tiles;
+}
+
+void DesktopSnapshot::paint(QPainter *painter, const QRect &region,
+                            std::function<bool(const Tile &)> skip) const
+{
+    auto tileSize = m_geometry.tileSize;
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        auto &tile = m_tiles.at(i);
+        if (!region.intersects(tile.rect) || (skip && skip(tile))) {
+            continue;
+        }
+        painter->drawImage(tile.rect.topLeft(), m_atlas,
+                           QRect(QPoint(0, i * tileSize.height()), tileSize));
+    }
+}
+
+void DesktopSnapshot::saveLater(const QString &path, const Geometry &geometry,
+                                const QVector<Tile> &tiles, const QImage &atlas)
+{
+    auto &queue = saveQueue();
+    {
+        QMutexLocker lock(&queue.mutex);
+        ++queue.pending;
+    }
+    QThreadPool::globalInstance()->start(new SaveJob(++queue.latest, path, geometry, tiles, atlas));
+}
+
+void DesktopSnapshot::waitForSaves()
+{
+    auto &queue = saveQueue();
+    QMutexLocker lock(&queue.mutex);
+    while (queue.pending > 0) {
+        queue.idle.wait(&queue.mutex);
+    }
+}
+
+bool DesktopSnapshot::save(const QString &path, const Geometry &geometry,
+                           const QVector<Tile> &tiles, const QImage &atlas)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    auto image = atlas.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    if (image.width() != geometry.tileSize.width()
+            || image.height() != geometry.tileSize.height() * tiles.size()) {
+        qWarning() << "desktop snapshot atlas does not match tiles" << image.size() << tiles.size();
+        return false;
+    }
+
+    QByteArray records;
+    for (auto &tile : tiles) {
+        auto name = tile.localFile.toUtf8();
+        putUInt16(records, tile.cell.x());
+        putUInt16(records, tile.cell.y());
+        putUInt32(records, static_cast<quint32>(tile.rect.x()));
+        putUInt32(records, static_cast<quint32>(tile.rect.y()));
+        putUInt16(records, name.size());
+        records.append(name);
+    }
+
+    qint64 atlasOffset = HeaderSize + records.size();
+    atlasOffset = (atlasOffset + AtlasAlignment - 1) / AtlasAlignment * AtlasAlignment;
+
+    QByteArray data(SnapshotMagic, sizeof(SnapshotMagic));
+    data.append(static_cast<char>(SnapshotVersion));
+    data.append(QByteArray(3, '\0'));
+    putUInt16(data, geometry.colCount);
+    putUInt16(data, geometry.rowCount);
+    putUInt16(data, geometry.cellSize.width());
+    putUInt16(data, geometry.cellSize.height());
+    putUInt16(data, geometry.tileSize.width());
+    putUInt16(data, geometry.tileSize.height());
+    putUInt16(data, geometry.iconLevel);
+    putUInt16(data, geometry.origin.x());
+    putUInt16(data, geometry.origin.y());
+    putUInt16(data, 0);
+    putUInt32(data, tiles.size());
+    putUInt32(data, atlasOffset);
+    data.append(records);
+    data.append(QByteArray(atlasOffset - data.size(), '\0'));
+
+    auto lineSize = geometry.tileSize.width() * 4;
+    data.reserve(atlasOffset + atlasBytes(geometry.tileSize, tiles.size()));
+    for (int y = 0; y < image.height(); ++y) {
+        data.append(reinterpret_cast<const char *>(image.constScanLine(y)), lineSize);
+    }
+
+    // a lost snapshot only costs one slow first paint
+    if (!AtomicFile::write(path, data, AtomicFile::DirSyncNever)) {
+        qWarning() << "save desktop snapshot failed" << path;
+        return false;
+    }
+
+    qDebug() << "save desktop snapshot" << path << data.size() << "bytes"
+             << tiles.size() << "tiles in" << timer.elapsed() << "ms";
+    return true;
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QSize>
+#include <QFile>
+
+#include <functional>
+
+class QPainter;
+
+// Rendered icon tiles of the last session.
+// The canvas paints them at login while the file model is still
+// enumerating the desktop, so the user sees the icons at once. The file
+// keeps the grid geometry, one record per item and a raw premultiplied
+// atlas; the atlas is memory mapped and wrapped by a QImage without copy.
+class DesktopSnapshot
+{
+public:
+    struct Tile {
+        QString localFile;
+        QPoint  cell;
+        QRect   rect;
+
+        bool operator==(const Tile &other) const;
+    };
+
+    struct Geometry {
+        int     colCount    = 0;
+        int     rowCount    = 0;
+        QSize   cellSize;
+        QSize   tileSize;
+        // top left of the grid inside the canvas
+        QPoint  origin;
+        int     iconLevel   = 0;
+
+        bool operator==(const Geometry &other) const;
+    };
+
+    explicit DesktopSnapshot(const QString &path);
+    ~DesktopSnapshot();
+
+    const QString &path() const;
+
+    bool load();
+    void clear();
+
+    bool isValid() const;
+    // tiles are only usable on the same grid they were rendered for
+    bool matches(const Geometry &geometry) const;
+    const QVector<Tile> &tiles() const;
+
+    // skip: tiles already covered by a real icon
+    void paint(QPainter *painter, const QRect &region,
+               std::function<bool(const Tile &)> skip = nullptr) const;
+
+    // tiles[i] is stored at row i of the atlas, tileSize high
+    static bool save(const QString &path, const Geometry &geometry,
+                     const QVector<Tile> &tiles, const QImage &atlas);
+    // save() on the global thread pool; of several queued saves only the
+    // last one is written
+    static void saveLater(const QString &path, const Geometry &geometry,
+                          const QVector<Tile> &tiles, const QImage &atlas);
+    // block until the queued saves are done
+    static void waitForSaves();
+
+private:
+    QString         m_path;
+    QFile           m_file;
+    uchar           *m_data = nullptr;
+
+    Geometry        m_geometry;
+    QVector<Tile>   m_tiles;
+    QImage          m_atlas;
+};
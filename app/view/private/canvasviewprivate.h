@@ -11,6 +11,7 @@
 
 #include <QtGlobal>
 #include <QModelIndex>
+#include <QPersistentModelIndex>
 #include <QSize>
 #include <QPoint>
 #include <QRect>
@@ -18,13 +19,18 @@
 #include <QItemSelection>
 #include <QDebug>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
 
-#include <dfilesystemwatcher.h>
 
 #include "../../global/coorinate.h"
+#include "../../model/itemregistry.h"
+#include "../desktopsnapshot.h"
 
 class QFrame;
 class CanvasViewHelper;
+class DesktopWatcher;
 
 class CanvasViewPrivate
 {
@@ -98,12 +104,22 @@ public:
         }
     }
 
+    // save the icon tiles once the desktop settles down
+    void scheduleSnapshot()
+    {
+        if (snapshotTimer) {
+            snapshotTimer->start();
+        }
+    }
+
 public:
 
     QMargins viewMargins;
     QMargins cellMargins;
 
-    bool hideItems  = false;
+    bool hideItems      = false;
+    bool painted        = false;
+    bool iconsVisible   = false;
 
     int rowCount;
     int colCount;
@@ -127,8 +143,36 @@ public:
 
     int                 resortCount;
 
+    // model index of every item on the grid, kept in step with the model
+    // so paint and hit tests never build a path or an url
+    QHash<ItemHandle, QPersistentModelIndex> itemIndexes;
+
     // secice system up
     QTimer              *syncTimer          = nullptr;
 //    qint64              lastRepaintTime     = 0;
-    DFileSystemWatcher  *filesystemWatcher  = nullptr;
+    DesktopWatcher      *desktopWatcher     = nullptr;
+    // polls for the desktop directory after it went away
+    QTimer              *rewatchTimer       = nullptr;
+
+    // icons of the last session, painted until the grid is inited
+    DesktopSnapshot     *snapshot           = nullptr;
+    QTimer              *snapshotTimer      = nullptr;
+    // what the last save was rendered from
+    bool                            snapshotSaved   = false;
+    DesktopSnapshot::Geometry       savedGeometry;
+    QVector<DesktopSnapshot::Tile>  savedTiles;
+
+    // rows inserted and removed within one window, file to added
+    static const int    TransactionFrame    = 16;
+    static const int    TransactionWindow   = 100;
+    QTimer              *transactionTimer   = nullptr;
+    QElapsedTimer       transactionAge;
+    QHash<QString, bool> pendingChanges;
+    QStringList         pendingOrder;
+    int                 pendingEvents       = 0;
+    quint64             transactionCount    = 0;
+    quint64             coalescedEvents     = 0;
+
+    // reconciles the grid once the model has listed the desktop
+    QTimer              *reconcileTimer     = nullptr;
 };
@@ -0,0 +1,34 @@
+include($$PWD/../build.pri)
+
+QT          += core gui widgets dbus
+TEMPLATE    = app
+CONFIG      += c++11 console link_pkgconfig
+CONFIG      -= app_bundle
+DESTDIR     = $$BUILD_DIST/benchmark
+
+APP_DIR     = $$PWD/../app
+INCLUDEPATH += $$APP_DIR $$PWD/common
+
+HEADERS += \
+    $$PWD/common/benchmark.h
+
+# layout persistence, built from the same files as app.pro
+LAYOUT_SOURCES = \
+    $$APP_DIR/config/config.cpp \
+    $$APP_DIR/config/layoutjournal.cpp \
+    $$APP_DIR/config/atomicfile.cpp \
+    $$APP_DIR/config/inilayoutstore.cpp \
+    $$APP_DIR/config/xattrlayoutstore.cpp \
+    $$APP_DIR/model/itemregistry.cpp
+
+LAYOUT_HEADERS = \
+    $$APP_DIR/config/config.h \
+    $$APP_DIR/config/layoutjournal.h \
+    $$APP_DIR/config/atomicfile.h \
+    $$APP_DIR/config/layoutstore.h \
+    $$APP_DIR/config/inilayoutstore.h \
+    $$APP_DIR/config/xattrlayoutstore.h \
+    $$APP_DIR/config/flushstats.h \
+    $$APP_DIR/config/configsnapshot.h \
+    $$APP_DIR/config/layoutopqueue.h \
+    $$APP_DIR/model/itemregistry.h
@@ -0,0 +1,13 @@
+#-------------------------------------------------
+#
+# Standalone benchmarks of the desktop layout code,
+# not part of the dde-desktop build.
+#
+#-------------------------------------------------
+
+TEMPLATE    = subdirs
+SUBDIRS     += gridmanager \
+               configstress \
+               layoutops \
+               layoutstore \
+               profilecheck
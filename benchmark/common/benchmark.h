@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+#pragma once
+
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <QFile>
+#include <QDir>
+
+// Helpers shared by the standalone benchmarks.
+namespace Benchmark
+{
+// Keep the benchmarks away from the user's real config and cache: Qt's
+// test mode moves every standard location under ~/.qttest, and the
+// benchmark gets a config file of its own there.
+inline QString isolate(const QString &name)
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setOrganizationName("deepin");
+    QCoreApplication::setApplicationName(name);
+
+    auto configDir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)
+                     + "/deepin/" + name;
+    QDir(configDir).removeRecursively();
+    QDir().mkpath(configDir);
+
+    auto scratch = QStandardPaths::writableLocation(QStandardPaths::TempLocation)
+                   + "/" + name;
+    QDir(scratch).removeRecursively();
+    QDir().mkpath(scratch);
+    return scratch;
+}
+
+// the compiler must assume value is read
+template <class T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Best of rounds, in nanoseconds per op. work runs ops operations.
+template <class Work>
+inline double nsPerOp(qint64 ops, Work work, int rounds = 5)
+{
+    double best = -1;
+    for (int i = 0; i < rounds; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        work();
+        auto ns = double(timer.nsecsElapsed()) / qMax<qint64>(1, ops);
+        if (best < 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+inline double msOf(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+// one fixed width row of a result table
+inline void row(const QStringList &columns, int width = 14)
+{
+    QTextStream out(stdout);
+    for (auto &column : columns) {
+        out << column.rightJustified(width);
+    }
+    out << "\n";
+}
+
+inline QString number(double value, int precision = 1)
+{
+    return QString::number(value, 'f', precision);
+}
+}
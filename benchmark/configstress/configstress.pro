@@ -0,0 +1,16 @@
+include(../benchmark.pri)
+
+TARGET      = configstress
+PKGCONFIG   += dde-file-manager
+
+# a data race check rather than a timing run
+QMAKE_CXXFLAGS  += -fsanitize=thread -fno-omit-frame-pointer -g -O1
+QMAKE_LFLAGS    += -fsanitize=thread
+
+SOURCES += \
+    main.cpp \
+    $$LAYOUT_SOURCES
+
+HEADERS += \
+    $$LAYOUT_HEADERS \
+    $$APP_DIR/global/coorinate.h
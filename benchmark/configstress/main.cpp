@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+// Snapshot publication under ThreadSanitizer. Reader threads keep taking
+// snapshots while the Config thread publishes a new one per write and the
+// main thread, the layout op producer, keeps the op ring busy.
+// Exits non-zero when a reader saw a torn or older snapshot; TSan reports
+// races on its own.
+
+#include <QApplication>
+#include <QStringList>
+#include <QVariantList>
+#include <QVector>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+
+#include "config/config.h"
+#include "model/itemregistry.h"
+
+namespace
+{
+const QString StressGroup = "Stress";
+const int ReaderCount = 4;
+const int WriteCount = 20000;
+const int OpsPerWrite = 8;
+const int ItemCount = 256;
+}
+
+int main(int argc, char *argv[])
+{
+    // Config follows QGuiApplication session signals, no display needed
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    auto root = Benchmark::isolate("dde-desktop-configstress");
+
+    auto registry = ItemRegistry::instance();
+    registry->setRootPath(root);
+    auto config = Config::instance();
+    // write like the desktop that owns the service name
+    QMetaObject::invokeMethod(config, "enablePersistence", Qt::QueuedConnection);
+
+    QVector<ItemHandle> items;
+    for (int i = 0; i < ItemCount; ++i) {
+        FileId id;
+        id.device = 1;
+        id.inode = static_cast<quint64>(i) + 1;
+        items << registry->intern(QString("%1/item-%2").arg(root).arg(i), id);
+    }
+
+    std::atomic<bool> stop {false};
+    std::atomic<quint64> reads {0};
+    std::atomic<quint64> failures {0};
+
+    // both keys are written by one setConfigList call, so every snapshot
+    // must hold the same counter in both, and versions never go back
+    std::vector<std::thread> readers;
+    for (int i = 0; i < ReaderCount; ++i) {
+        readers.emplace_back([&]() {
+            quint64 lastVersion = 0;
+            quint64 count = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto snapshot = config->snapshot();
+                auto first = snapshot->value(StressGroup, "First").toULongLong();
+                auto second = snapshot->value(StressGroup, "Second").toULongLong();
+                if (first != second || snapshot->version() < lastVersion) {
+                    ++failures;
+                }
+                lastVersion = snapshot->version();
+                ++count;
+            }
+            reads += count;
+        });
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    config->pushLayoutOp(LayoutOp::SelectProfile, ItemRegistry::InvalidHandle, Coordinate(16, 16).key());
+    for (int i = 1; i <= WriteCount; ++i) {
+        QMetaObject::invokeMethod(config, "setConfigList", Qt::QueuedConnection,
+                                  Q_ARG(QString, StressGroup),
+                                  Q_ARG(QStringList, QStringList() << "First" << "Second"),
+                                  Q_ARG(QVariantList, QVariantList() << i << i));
+        for (int op = 0; op < OpsPerWrite; ++op) {
+            auto n = i * OpsPerWrite + op;
+            config->pushLayoutOp(LayoutOp::SetCell, items.value(n % ItemCount),
+                                 Coordinate(n % 16, (n / 16) % 16).key());
+        }
+        config->commitLayoutOps();
+    }
+    config->flushSync();
+    auto elapsed = Benchmark::msOf(timer);
+
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    auto last = config->value(StressGroup, "First").toInt();
+    if (last != WriteCount) {
+        ++failures;
+    }
+
+    Benchmark::row(QStringList() << "writes" << "readers" << "reads" << "ms" << "failures");
+    Benchmark::row(QStringList() << QString::number(WriteCount) << QString::number(ReaderCount)
+                   << QString::number(reads) << Benchmark::number(elapsed)
+                   << QString::number(failures));
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+// Placement and lookup cost of GridManager at 1k, 10k and 100k items.
+// paintEvent and setSelection look up every cell per frame, so the
+// per-lookup cost times the cell count is what a repaint pays.
+
+#include <QApplication>
+#include <QStringList>
+#include <QVector>
+#include <QtMath>
+
+#include "benchmark.h"
+
+#include "config/config.h"
+#include "model/itemregistry.h"
+#include "presenter/gridmanager.h"
+
+namespace
+{
+const int ItemCounts[] = {1000, 10000, 100000};
+const int MoveCount = 1000;
+}
+
+int main(int argc, char *argv[])
+{
+    // Config follows QGuiApplication session signals, no display needed
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    auto root = Benchmark::isolate("dde-desktop-gridmanager-benchmark");
+
+    auto registry = ItemRegistry::instance();
+    registry->setRootPath(root);
+    auto grid = GridManager::instance();
+    // write like the desktop that owns the service name
+    QMetaObject::invokeMethod(Config::instance(), "enablePersistence", Qt::QueuedConnection);
+
+    Benchmark::row(QStringList() << "items" << "cells" << "place ms"
+                   << "item(x,y) ns" << "pos(item) ns" << "isEmpty ns"
+                   << "pos(name) ns" << "move us");
+
+    for (auto count : ItemCounts) {
+        // a quarter of the cells stay free, like a busy desktop
+        auto cells = count * 5 / 4;
+        auto h = qCeil(qSqrt(cells * 10 / 16.0));
+        auto w = qCeil(double(cells) / h);
+
+        grid->clear();
+        grid->updateGridSize(w, h);
+
+        // the inodes come with the names, as from the directory listing
+        QStringList files;
+        QVector<ItemHandle> items;
+        for (int i = 0; i < count; ++i) {
+            auto localFile = QString("%1/item-%2-%3").arg(root).arg(count).arg(i);
+            FileId id;
+            id.device = 1;
+            id.inode = static_cast<quint64>(count) * 1000000 + i + 1;
+            files << localFile;
+            items << registry->intern(localFile, id);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        grid->initProfile(files);
+        auto placeMs = Benchmark::msOf(timer);
+
+        auto cellLookup = Benchmark::nsPerOp(qint64(w) * h, [&]() {
+            for (int x = 0; x < w; ++x) {
+                for (int y = 0; y < h; ++y) {
+                    Benchmark::keep(grid->item(x, y));
+                }
+            }
+        });
+
+        auto itemLookup = Benchmark::nsPerOp(count, [&]() {
+            for (auto item : items) {
+                Benchmark::keep(grid->position(item));
+            }
+        });
+
+        auto emptyLookup = Benchmark::nsPerOp(qint64(w) * h, [&]() {
+            for (int x = 0; x < w; ++x) {
+                for (int y = 0; y < h; ++y) {
+                    Benchmark::keep(grid->isEmpty(x, y));
+                }
+            }
+        });
+
+        auto nameLookup = Benchmark::nsPerOp(count, [&]() {
+            for (auto &localFile : files) {
+                Benchmark::keep(grid->position(localFile));
+            }
+        }, 1);
+
+        // move one icon back and forth between its cell and the last,
+        // always free, cell; every move persists one cell
+        auto item = items.first();
+        auto home = grid->position(item);
+        auto spare = QPoint(w - 1, h - 1);
+        auto moveCost = Benchmark::nsPerOp(MoveCount, [&]() {
+            for (int i = 0; i < MoveCount; ++i) {
+                auto dest = (i % 2) ? home : spare;
+                grid->move(QList<ItemHandle>() << item, item, dest.x(), dest.y());
+            }
+        }, 1);
+
+        Benchmark::row(QStringList() << QString::number(count) << QString::number(w * h)
+                       << Benchmark::number(placeMs) << Benchmark::number(cellLookup)
+                       << Benchmark::number(itemLookup) << Benchmark::number(emptyLookup)
+                       << Benchmark::number(nameLookup) << Benchmark::number(moveCost / 1000, 2));
+    }
+
+    grid->clear();
+    Config::instance()->flushSync();
+    return 0;
+}
@@ -0,0 +1,12 @@
+include(../benchmark.pri)
+
+TARGET      = layoutops-benchmark
+PKGCONFIG   += dde-file-manager
+
+SOURCES += \
+    main.cpp \
+    $$LAYOUT_SOURCES
+
+HEADERS += \
+    $$LAYOUT_HEADERS \
+    $$APP_DIR/global/coorinate.h
@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+// Cost per position edit of the layout op queue against a queued
+// setConfig call, the path GridManager used before. "push" is what the
+// GUI thread pays, "applied" lasts until Config has taken every op in.
+
+#include <QApplication>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+
+#include "benchmark.h"
+
+#include "config/config.h"
+#include "model/itemregistry.h"
+
+namespace
+{
+const int GridSize = 100;
+const int OpCounts[] = {1000, 100000};
+// a GUI frame commits a batch of this many ops
+const int BatchSize = 64;
+}
+
+static double waitApplied(Config *config, quint64 target, const QElapsedTimer &timer)
+{
+    while (config->opsReceived() < target) {
+        QThread::yieldCurrentThread();
+    }
+    return timer.nsecsElapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    // Config follows QGuiApplication session signals, no display needed
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    auto root = Benchmark::isolate("dde-desktop-layoutops-benchmark");
+
+    auto registry = ItemRegistry::instance();
+    registry->setRootPath(root);
+    auto config = Config::instance();
+    // write like the desktop that owns the service name
+    QMetaObject::invokeMethod(config, "enablePersistence", Qt::QueuedConnection);
+
+    QVector<ItemHandle> items;
+    QStringList files;
+    for (int i = 0; i < GridSize * GridSize; ++i) {
+        FileId id;
+        id.device = 1;
+        id.inode = static_cast<quint64>(i) + 1;
+        files << QString("%1/item-%2").arg(root).arg(i);
+        items << registry->intern(files.last(), id);
+    }
+    auto profile = Coordinate(GridSize, GridSize).key();
+    auto profileName = QString("Position_%1x%2").arg(GridSize).arg(GridSize);
+
+    Benchmark::row(QStringList() << "path" << "ops" << "push ns" << "applied ns");
+
+    for (auto count : OpCounts) {
+        // ring: handles and packed cells, names are looked up at flush
+        config->flushSync();
+        auto target = config->opsReceived() + count;
+        QElapsedTimer timer;
+        timer.start();
+        config->pushLayoutOp(LayoutOp::SelectProfile, ItemRegistry::InvalidHandle, profile);
+        for (int i = 0; i < count; ++i) {
+            auto cell = i % items.size();
+            config->pushLayoutOp(LayoutOp::SetCell, items.value(cell),
+                                 Coordinate(cell / GridSize, cell % GridSize).key());
+            if (0 == (i + 1) % BatchSize) {
+                config->commitLayoutOps();
+            }
+        }
+        config->commitLayoutOps();
+        auto pushNs = timer.nsecsElapsed();
+        auto appliedNs = waitApplied(config, target, timer);
+        Benchmark::row(QStringList() << "ring" << QString::number(count)
+                       << Benchmark::number(double(pushNs) / count)
+                       << Benchmark::number(appliedNs / count));
+
+        // queued signal: one boxed key and name per op
+        config->flushSync();
+        target = config->opsReceived() + count;
+        timer.restart();
+        for (int i = 0; i < count; ++i) {
+            auto cell = i % items.size();
+            QMetaObject::invokeMethod(config, "setConfig", Qt::QueuedConnection,
+                                      Q_ARG(QString, profileName),
+                                      Q_ARG(QString, QString("%1_%2").arg(cell / GridSize).arg(cell % GridSize)),
+                                      Q_ARG(QVariant, registry->localFile(items.value(cell))));
+        }
+        pushNs = timer.nsecsElapsed();
+        appliedNs = waitApplied(config, target, timer);
+        Benchmark::row(QStringList() << "queued" << QString::number(count)
+                       << Benchmark::number(double(pushNs) / count)
+                       << Benchmark::number(appliedNs / count));
+    }
+
+    config->flushSync();
+    return 0;
+}
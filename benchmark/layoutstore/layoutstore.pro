@@ -0,0 +1,17 @@
+include(../benchmark.pri)
+
+TARGET      = layoutstore-benchmark
+
+SOURCES += \
+    main.cpp \
+    $$APP_DIR/config/layoutjournal.cpp \
+    $$APP_DIR/config/atomicfile.cpp \
+    $$APP_DIR/config/inilayoutstore.cpp \
+    $$APP_DIR/config/xattrlayoutstore.cpp
+
+HEADERS += \
+    $$APP_DIR/config/layoutstore.h \
+    $$APP_DIR/config/layoutjournal.h \
+    $$APP_DIR/config/atomicfile.h \
+    $$APP_DIR/config/inilayoutstore.h \
+    $$APP_DIR/config/xattrlayoutstore.h
@@ -0,0 +1,167 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+// Load, move and realign cost of the position profile backends with a
+// 10k entry profile. Bytes are what the backend wrote to disk, so the
+// bytes of one move are its write amplification. The xattr store keeps
+// its data in the attributes of the desktop files, not in a file of
+// its own, so its file bytes stay 0.
+
+#include <QCoreApplication>
+#include <QSettings>
+#include <QScopedPointer>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include <functional>
+
+#include "benchmark.h"
+
+#include "config/inilayoutstore.h"
+#include "config/layoutjournal.h"
+#include "config/xattrlayoutstore.h"
+
+namespace
+{
+const int EntryCount = 10000;
+const int GridHeight = 100;
+const int MoveCount = 200;
+const QString Profile = "Position_100x100";
+
+QString cellKey(int index)
+{
+    return QString("%1_%2").arg(index / GridHeight).arg(index % GridHeight);
+}
+
+// one backend over the files in dir, created or opened again
+struct Backend {
+    QString name;
+    std::function<LayoutStore *(const QString &dir)> open;
+    // settings the store works on, deleted with it
+    QScopedPointer<QSettings> settings;
+};
+
+qint64 directorySize(const QString &dir)
+{
+    qint64 size = 0;
+    for (auto &info : QDir(dir).entryInfoList(QDir::Files | QDir::NoDotAndDotDot)) {
+        size += info.size();
+    }
+    return size;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    auto scratch = Benchmark::isolate("dde-desktop-layoutstore-benchmark");
+
+    // real, empty files, the xattr store writes to their inodes
+    auto desktop = scratch + "/desktop";
+    QDir().mkpath(desktop);
+    QStringList files;
+    for (int i = 0; i < EntryCount; ++i) {
+        files << QString("%1/file-%2.txt").arg(desktop).arg(i, 5, 10, QChar('0'));
+        QFile(files.last()).open(QIODevice::WriteOnly);
+    }
+
+    QList<Backend *> backends;
+
+    auto ini = new Backend;
+    ini->name = "ini";
+    ini->open = [ini](const QString & dir) -> LayoutStore * {
+        // QSettings parses the file on first access, inside load()
+        ini->settings.reset(new QSettings(dir + "/dde-desktop.conf", QSettings::IniFormat));
+        return new IniLayoutStore(ini->settings.data());
+    };
+    backends << ini;
+
+    auto journal = new Backend;
+    journal->name = "journal";
+    journal->open = [](const QString & dir) -> LayoutStore * {
+        return new LayoutJournal(dir + "/layout.journal");
+    };
+    backends << journal;
+
+    auto xattr = new Backend;
+    xattr->name = "xattr";
+    xattr->open = [desktop](const QString & dir) -> LayoutStore * {
+        return new XattrLayoutStore(desktop, new LayoutJournal(dir + "/layout-fallback.journal"));
+    };
+    backends << xattr;
+
+    Benchmark::row(QStringList() << "backend" << "entries" << "fill ms" << "load ms"
+                   << "move us" << "move bytes" << "realign ms" << "realign bytes"
+                   << "file bytes");
+
+    for (auto backend : backends) {
+        auto dir = scratch + "/" + backend->name;
+        QDir().mkpath(dir);
+
+        // first write of the whole profile
+        QScopedPointer<LayoutStore> store(backend->open(dir));
+        store->load();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < EntryCount; ++i) {
+            store->setValue(Profile, cellKey(i), files.at(i));
+        }
+        store->sync();
+        auto fillMs = Benchmark::msOf(timer);
+        store.reset();
+
+        // start up again the way Config does: load, then read the profile
+        timer.start();
+        store.reset(backend->open(dir));
+        store->load();
+        auto values = store->values(Profile);
+        auto loadMs = Benchmark::msOf(timer);
+        Benchmark::keep(values);
+        if (values.size() != EntryCount) {
+            qWarning() << backend->name << "loaded" << values.size() << "of" << EntryCount << "entries";
+        }
+
+        // one icon to a free cell and back, each move flushed on its own
+        auto bytes = store->bytesWritten();
+        timer.start();
+        for (int i = 0; i < MoveCount; ++i) {
+            auto from = (i % 2) ? EntryCount : 0;
+            auto to = (i % 2) ? 0 : EntryCount;
+            store->remove(Profile, cellKey(from));
+            store->setValue(Profile, cellKey(to), files.first());
+            store->sync();
+        }
+        auto moveUs = timer.nsecsElapsed() / 1000.0 / MoveCount;
+        auto moveBytes = double(store->bytesWritten() - bytes) / MoveCount;
+
+        // auto arrange rewrites the whole profile
+        bytes = store->bytesWritten();
+        timer.start();
+        store->remove(Profile, QString());
+        for (int i = 0; i < EntryCount; ++i) {
+            store->setValue(Profile, cellKey(EntryCount - 1 - i), files.at(i));
+        }
+        store->sync();
+        auto realignMs = Benchmark::msOf(timer);
+        auto realignBytes = store->bytesWritten() - bytes;
+
+        Benchmark::row(QStringList() << backend->name << QString::number(EntryCount)
+                       << Benchmark::number(fillMs) << Benchmark::number(loadMs)
+                       << Benchmark::number(moveUs) << Benchmark::number(moveBytes, 0)
+                       << Benchmark::number(realignMs) << QString::number(realignBytes)
+                       << QString::number(directorySize(dir)));
+
+        store.reset();
+    }
+
+    qDeleteAll(backends);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright (C) 2016 Deepin Technology Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ **/
+
+// Loads a position profile with a cell outside the grid and checks that
+// every item ends up in exactly one cell, also after the overlap cell is
+// freed and refilled. Exits non-zero on a failure.
+
+#include <QApplication>
+#include <QStringList>
+#include <QVector>
+#include <QDebug>
+
+#include "benchmark.h"
+
+#include "config/config.h"
+#include "model/itemregistry.h"
+#include "presenter/gridmanager.h"
+
+namespace
+{
+const int GridSize = 4;
+
+// every item sits in one cell and position() agrees with it
+bool checkPlacement(const QString &stage, const QVector<ItemHandle> &items,
+                    const QVector<ItemHandle> &gone)
+{
+    auto grid = GridManager::instance();
+    auto ok = true;
+
+    for (auto item : items) {
+        auto cells = 0;
+        QPoint cell;
+        for (int x = 0; x < GridSize; ++x) {
+            for (int y = 0; y < GridSize; ++y) {
+                if (grid->item(x, y) == item) {
+                    ++cells;
+                    cell = QPoint(x, y);
+                }
+            }
+        }
+
+        auto expected = gone.contains(item) ? 0 : 1;
+        if (cells != expected) {
+            qCritical() << stage << ItemRegistry::instance()->localFile(item)
+                        << "in" << cells << "cells, expected" << expected;
+            ok = false;
+        } else if (1 == cells && grid->position(item) != cell) {
+            qCritical() << stage << ItemRegistry::instance()->localFile(item)
+                        << "in cell" << cell << "but position()" << grid->position(item);
+            ok = false;
+        }
+    }
+
+    if (!grid->overlapItems().isEmpty()) {
+        qCritical() << stage << grid->overlapItems().size() << "items left on the overlap list";
+        ok = false;
+    }
+    return ok;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // Config follows QGuiApplication session signals, no display needed
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    auto root = Benchmark::isolate("dde-desktop-profilecheck");
+
+    auto registry = ItemRegistry::instance();
+    registry->setRootPath(root);
+    auto config = Config::instance();
+
+    // saved cells must stay where they are
+    QMetaObject::invokeMethod(config, "setConfig", Qt::QueuedConnection,
+                              Q_ARG(QString, Config::groupGeneral),
+                              Q_ARG(QString, Config::keyAutoAlign),
+                              Q_ARG(QVariant, false));
+
+    // the first items fill all but the last two cells, the next one is
+    // saved on the overlap cell and the last one outside the grid
+    auto profileName = QString("Position_%1x%2").arg(GridSize).arg(GridSize);
+    auto cellCount = GridSize * GridSize;
+    QStringList files;
+    for (int i = 0; i < cellCount; ++i) {
+        files << QString("%1/item-%2").arg(root).arg(i);
+
+        QString key;
+        if (i < cellCount - 2) {
+            key = QString("%1_%2").arg(i / GridSize).arg(i % GridSize);
+        } else if (i == cellCount - 2) {
+            key = QString("%1_%2").arg(GridSize - 1).arg(GridSize - 1);
+        } else {
+            key = QString("%1_%2").arg(GridSize * 2).arg(GridSize * 2);
+        }
+        QMetaObject::invokeMethod(config, "setConfig", Qt::QueuedConnection,
+                                  Q_ARG(QString, profileName),
+                                  Q_ARG(QString, key),
+                                  Q_ARG(QVariant, files.last()));
+    }
+    config->flushSync();
+
+    auto grid = GridManager::instance();
+    grid->updateGridSize(GridSize, GridSize);
+    grid->initProfile(files);
+
+    QVector<ItemHandle> items;
+    for (auto &file : files) {
+        items << registry->find(file);
+    }
+
+    auto ok = checkPlacement("load", items, QVector<ItemHandle>());
+
+    // freeing the overlap cell refills it from the overlap list
+    auto overlapItem = items.value(cellCount - 2);
+    grid->remove(files.value(cellCount - 2));
+    ok &= checkPlacement("free overlap cell", items, QVector<ItemHandle>() << overlapItem);
+
+    qDebug() << (ok ? "profile check passed" : "profile check failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+include(../benchmark.pri)
+
+TARGET      = profilecheck
+PKGCONFIG   += dde-file-manager
+
+SOURCES += \
+    main.cpp \
+    $$LAYOUT_SOURCES \
+    $$APP_DIR/presenter/gridmanager.cpp \
+    $$APP_DIR/presenter/apppresenter.cpp \
+    $$APP_DIR/util/trace/trace.cpp
+
+HEADERS += \
+    $$LAYOUT_HEADERS \
+    $$APP_DIR/global/cellbitmap.h \
+    $$APP_DIR/global/coorinate.h \
+    $$APP_DIR/presenter/gridmanager.h \
+    $$APP_DIR/presenter/apppresenter.h \
+    $$APP_DIR/util/trace/trace.h